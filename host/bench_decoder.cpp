@@ -0,0 +1,197 @@
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+#include "sim.hpp"
+#include "legacy_quadrature_decoder.hpp"
+#include "rotary_encoder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#endif
+
+// Replays the same edge traces through QuadratureDecoder and the switch-based
+// decoder it replaced, then reports the cost of each per edge and how far
+// each one's count strays from the true knob position.
+//
+// The clean spin trace must decode identically in both; the exit code is
+// non-zero otherwise. The other traces exist to show where they differ.
+//
+// usage: bench_decoder [edges per trace]
+
+#define DEFAULT_BENCH_EDGES 4000000
+#define BENCH_SEED 0x5eed
+#define BENCH_REPEATS 5
+#define BENCH_MISSED_EDGE_PERCENT 1
+
+struct TraceEdge {
+    RotaryEncoderEvent event;  // For the legacy decoder
+    TimedRotaryEncoderEvent levels;
+};
+
+struct Trace {
+    const char *name;
+    bool must_match;
+    std::vector<TraceEdge> edges;
+    int64_t true_steps;  // Net right minus left steps the knob actually made
+};
+
+// Pin states for one full quadrature cycle turning right
+static const RotaryEncoderState QUADRATURE_CYCLE[4] = { BOTH_DOWN, RIGHT_UP, BOTH_UP, LEFT_UP };
+
+static RotaryEncoderEvent edge_between(RotaryEncoderState from, RotaryEncoderState to) {
+    uint changed = from ^ to;
+    bool left = changed & LEFT_UP;
+    bool level = to & changed;
+    return (RotaryEncoderEvent)((left ? 0 : 2) | (level ? 1 : 0));
+}
+
+// A knob turning back and forth with min_us to max_us between edges. Apart
+// from consensus at reversals, every step should count. With
+// missed_percent > 0 that share of edges never reaches the decoder, as when
+// two edges land in one interrupt.
+static Trace make_spin_trace(const char *name, bool must_match, uint min_us, uint max_us, uint edges, uint missed_percent, std::mt19937 &rng) {
+    Trace trace { name, must_match, {}, 0 };
+    std::uniform_int_distribution<uint> interval(min_us, max_us);
+    std::uniform_int_distribution<uint> run(8, 400);
+    std::uniform_int_distribution<uint> percent(0, 99);
+    uint32_t now = 0xFFF00000u;
+    uint phase = 0;
+    int direction = 1;
+    uint remaining = run(rng);
+    while (trace.edges.size() < edges) {
+        if (remaining-- == 0) {
+            direction = -direction;
+            remaining = run(rng);
+        }
+        uint next = (phase + 4 + direction) % 4;
+        now += interval(rng);
+        trace.true_steps += direction;
+        RotaryEncoderState from = QUADRATURE_CYCLE[phase];
+        RotaryEncoderState to = QUADRATURE_CYCLE[next];
+        phase = next;
+        if (percent(rng) < missed_percent) {
+            continue;
+        }
+        trace.edges.push_back({ edge_between(from, to), { to, now } });
+    }
+    return trace;
+}
+
+// Arbitrary pin flips at arbitrary intervals
+static Trace make_noise_trace(uint edges, std::mt19937 &rng) {
+    Trace trace { "noise", false, {}, 0 };
+    std::uniform_int_distribution<uint> interval(0, 2000);
+    std::uniform_int_distribution<uint> event(LEFT_EDGE_FALL, RIGHT_EDGE_RISE);
+    uint32_t now = 0;
+    uint state = BOTH_DOWN;
+    while (trace.edges.size() < edges) {
+        now += interval(rng);
+        RotaryEncoderEvent edge = (RotaryEncoderEvent)event(rng);
+        uint pin_bit = (edge & 2) ? RIGHT_UP : LEFT_UP;
+        state = (edge & 1) ? (state | pin_bit) : (state & ~pin_bit);
+        trace.edges.push_back({ edge, { (RotaryEncoderState)state, now } });
+    }
+    return trace;
+}
+
+static RotaryEncoderDecision decode(LegacyQuadratureDecoder &decoder, const TraceEdge &edge) {
+    return decoder.decode(edge.event, edge.levels.time);
+}
+
+static RotaryEncoderDecision decode(QuadratureDecoder &decoder, const TraceEdge &edge) {
+    return decoder.decode(edge.levels.state, edge.levels.time);
+}
+
+template <typename Decoder>
+static uint64_t replay(const Trace &trace, std::vector<uint8_t> &decisions) {
+    Decoder decoder;
+    decoder.reset(BOTH_DOWN);
+    decisions.resize(trace.edges.size());
+    const TraceEdge *edges = trace.edges.data();
+    uint8_t *out = decisions.data();
+    uint64_t start = 0;
+    #ifdef BENCH_HAS_TSC
+    start = __rdtsc();
+    #endif
+    for (size_t i = 0; i < trace.edges.size(); ++i) {
+        out[i] = decode(decoder, edges[i]);
+    }
+    #ifdef BENCH_HAS_TSC
+    return __rdtsc() - start;
+    #else
+    return start;
+    #endif
+}
+
+// Best of BENCH_REPEATS, to keep scheduler noise out of the comparison
+template <typename Decoder>
+static double time_replay(const Trace &trace, std::vector<uint8_t> &decisions, double &cycles_per_edge) {
+    double best_ns = 0;
+    for (uint repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t cycles = replay<Decoder>(trace, decisions);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double ns = elapsed * 1e9 / trace.edges.size();
+        if (repeat == 0 || ns < best_ns) {
+            best_ns = ns;
+            cycles_per_edge = (double)cycles / trace.edges.size();
+        }
+    }
+    return best_ns;
+}
+
+static int64_t net_steps(const std::vector<uint8_t> &decisions) {
+    int64_t steps = 0;
+    for (uint8_t decision : decisions) {
+        steps += (decision == DECODE_ROTATE_RIGHT) - (decision == DECODE_ROTATE_LEFT);
+    }
+    return steps;
+}
+
+static void print_decoder(const char *name, double ns, double cycles, int64_t steps, const Trace &trace) {
+    printf("  %-16s %.2f ns/edge", name, ns);
+    #ifdef BENCH_HAS_TSC
+    printf(", %.1f cycles/edge", cycles);
+    #else
+    (void)cycles;
+    #endif
+    printf(", net steps %lld (true %lld)\n", (long long)steps, (long long)trace.true_steps);
+}
+
+int main(int argc, char **argv) {
+    uint edges = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_BENCH_EDGES;
+    std::mt19937 rng(BENCH_SEED);
+    Trace traces[] = {
+        // Slow enough that the legacy decoder's rate limit never drops a step
+        make_spin_trace("spin", true, LEGACY_MIN_US_DIFF_TO_SEND + 1, 3000, edges, 0, rng),
+        make_spin_trace("fast spin", false, 100, LEGACY_MIN_US_DIFF_TO_SEND, edges, 0, rng),
+        make_spin_trace("spin, missed edges", false, LEGACY_MIN_US_DIFF_TO_SEND + 1, 3000, edges, BENCH_MISSED_EDGE_PERCENT, rng),
+        make_noise_trace(edges, rng),
+    };
+
+    int result = 0;
+    for (const Trace &trace : traces) {
+        std::vector<uint8_t> legacy_decisions;
+        std::vector<uint8_t> table_decisions;
+        double legacy_cycles = 0;
+        double table_cycles = 0;
+        double table_ns = time_replay<QuadratureDecoder>(trace, table_decisions, table_cycles);
+        double legacy_ns = time_replay<LegacyQuadratureDecoder>(trace, legacy_decisions, legacy_cycles);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < trace.edges.size(); ++i) {
+            mismatches += legacy_decisions[i] != table_decisions[i];
+        }
+        if (trace.must_match && mismatches != 0) {
+            result = 1;
+        }
+
+        printf("%s trace (%zu edges)\n", trace.name, trace.edges.size());
+        print_decoder("switch decoder:", legacy_ns, legacy_cycles, net_steps(legacy_decisions), trace);
+        print_decoder("table decoder:", table_ns, table_cycles, net_steps(table_decisions), trace);
+        printf("  differing decisions: %zu%s\n", mismatches, trace.must_match ? "" : " (expected)");
+    }
+    return result;
+}
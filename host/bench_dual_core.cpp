@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "sim.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "report_mailbox.hpp"
+#include "rotary_encoder.hpp"
+
+// Measures input-to-report latency, from an edge's ISR timestamp to the
+// moment a report holding it is ready for the USB stack, while the USB side
+// is kept busy. One thread plays the GPIO interrupt and spins the knob in
+// real time. In "single" mode another thread runs main()'s single-core loop,
+// where every tud_task() stalls decoding. In "dual" mode one thread runs
+// core 1's decode loop and publishes through the ReportMailbox while a
+// second stands in for core 0 and its tud_task(). Dual mode needs a host
+// with at least three free cores for the numbers to mean anything.
+//
+// usage: bench_dual_core single|dual [us of usb work per tud_task] [edges] [us between edges]
+
+#define BUTTON_0_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+
+#define DEFAULT_BENCH_USB_WORK_US 500llu
+#define DEFAULT_BENCH_EDGES 20000llu
+#define DEFAULT_BENCH_EDGE_INTERVAL_US 50llu
+
+static std::atomic<bool> BENCH_DONE { false };
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+static void busy_wait_until(uint64_t deadline) {
+    while (time_us_64() < deadline) { }
+}
+
+// Stands in for tud_task() servicing a burst of control transfers
+static void usb_work(uint64_t usb_work_us) {
+    busy_wait_until(time_us_64() + usb_work_us);
+}
+
+static void spin_knob(uint64_t total_edges, uint64_t edge_interval_us) {
+    uint64_t next_edge = time_us_64();
+    uint phase = 0;
+    for (uint64_t edge = 0; edge < total_edges; ++edge) {
+        next_edge += edge_interval_us;
+        busy_wait_until(next_edge);
+        phase = (phase + SIM_QUADRATURE_PHASES - 1) % SIM_QUADRATURE_PHASES;  // Turning left
+        sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+    }
+    BENCH_DONE.store(true, std::memory_order_release);
+}
+
+// Drains the queue like main() and keeps every event's timestamp
+static void drain_events(Event* events, std::vector<uint32_t> &pending_times) {
+    uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    while (num_events > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(events[i]);
+            pending_times.push_back(events[i].time);
+        }
+        num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    }
+}
+
+static bool apply_inputs_to_report(Joystick* stick, report &r) {
+    bool changed = false;
+    if (stick->has_changes()) {
+        stick->apply_to_report(r);
+        changed = true;
+    }
+    if (buttons_have_changes()) {
+        apply_buttons_to_report(r);
+        changed = true;
+    }
+    return changed;
+}
+
+static void record_latencies(std::vector<uint32_t> &pending_times, std::vector<uint32_t> &latencies) {
+    const uint32_t now = time_us_32();
+    for (uint32_t time : pending_times) {
+        latencies.push_back(now - time);
+    }
+    pending_times.clear();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || (strcmp(argv[1], "single") != 0 && strcmp(argv[1], "dual") != 0)) {
+        fprintf(stderr, "usage: %s single|dual [us of usb work per tud_task] [edges] [us between edges]\n", argv[0]);
+        return 2;
+    }
+    const bool dual_core = strcmp(argv[1], "dual") == 0;
+    uint64_t usb_work_us = argc > 2 ? strtoull(argv[2], nullptr, 10) : DEFAULT_BENCH_USB_WORK_US;
+    uint64_t total_edges = argc > 3 ? strtoull(argv[3], nullptr, 10) : DEFAULT_BENCH_EDGES;
+    uint64_t edge_interval_us = argc > 4 ? strtoull(argv[4], nullptr, 10) : DEFAULT_BENCH_EDGE_INTERVAL_US;
+
+    sim_reset();
+    sim_use_wall_clock();
+    init_joystick();
+    init_input_handlers();
+    Joystick* stick = get_joystick();
+
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    ReportMailbox mailbox;
+    std::vector<uint32_t> latencies;
+    latencies.reserve(total_edges * 2);
+    uint64_t reports = 0;
+
+    std::thread knob(spin_knob, total_edges, edge_interval_us);
+
+    if (dual_core) {
+        std::thread usb([&mailbox, &reports, usb_work_us]() {
+            report staged = report {};
+            LatencyStamp stamp;
+            uint32_t sequence = 0;
+            while (!BENCH_DONE.load(std::memory_order_acquire)) {
+                usb_work(usb_work_us);
+                if (mailbox.read_if_newer(staged, stamp, sequence)) {
+                    ++reports;
+                }
+            }
+        });
+        report r = report {};
+        Event events[EVENT_DRAIN_BATCH_LENGTH];
+        std::vector<uint32_t> pending_times;
+        bool done;
+        do {
+            done = BENCH_DONE.load(std::memory_order_acquire);  // The pass after the last edge drains it
+            drain_events(events, pending_times);
+            settle_buttons(time_us_32());
+            emit_rotary_encoder_rotations();
+            if (apply_inputs_to_report(stick, r)) {
+                mailbox.publish(r, take_decoded_latency_stamp());
+            }
+            record_latencies(pending_times, latencies);
+        } while (!done);
+        usb.join();
+    }
+    else {
+        report staged = report {};
+        Event events[EVENT_DRAIN_BATCH_LENGTH];
+        std::vector<uint32_t> pending_times;
+        bool done;
+        do {
+            done = BENCH_DONE.load(std::memory_order_acquire);  // The pass after the last edge drains it
+            drain_events(events, pending_times);
+            settle_buttons(time_us_32());
+            emit_rotary_encoder_rotations();
+            if (apply_inputs_to_report(stick, staged)) {
+                ++reports;
+            }
+            record_latencies(pending_times, latencies);
+            usb_work(usb_work_us);
+        } while (!done);
+    }
+    knob.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](uint permille) {
+        return latencies.empty() ? 0u : latencies[(latencies.size() - 1) * permille / 1000];
+    };
+    printf("mode:          %s\n", dual_core ? "dual" : "single");
+    printf("usb work:      %llu us\n", (unsigned long long)usb_work_us);
+    printf("events:        %zu\n", latencies.size());
+    printf("reports:       %llu\n", (unsigned long long)reports);
+    printf("latency p50:   %u us\n", percentile(500));
+    printf("latency p99:   %u us\n", percentile(990));
+    printf("latency max:   %u us\n", percentile(1000));
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+#include "sim.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+
+// Stalls the main loop while adversarial bursts hit the pins through the
+// bank interrupt, then lets it catch up, once with the default pair window
+// and once with cancelling turned off. For each run it reports:
+//
+//   edges      pin changes during the stall
+//   Medges/s   host throughput of the interrupt path over the burst
+//   cancelled  edge pairs taken back before they reached the queue
+//   dropped    edges that found the queue full
+//   error      knob counts gained or lost against the true position
+//
+// The exit code is non-zero if the pipeline ends up disagreeing with the pins
+// after any run, or if cancelling fails to keep a chattering contact from
+// dropping edges or moving the knob.
+//
+// usage: bench_overload [stall repeats per scenario]
+
+#define ROTARY_0_GPIO_0 CONTROLLER_LAYOUT.encoders[0].gpio_left
+#define ROTARY_0_GPIO_1 CONTROLLER_LAYOUT.encoders[0].gpio_right
+#define BUTTON_0_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+
+#define DEFAULT_BENCH_REPEATS 20
+#define BENCH_SEED 0x5eed
+#define BENCH_LOOP_US 1000
+#define BENCH_CATCH_UP_US 20000  // After a stall, longer than any button lockout
+
+enum Burst {
+    BURST_BUTTON_BUZZ,  // The button toggling every few us
+    BURST_KNOB_RINGING,  // A slow turn with every edge ringing hard
+    BURST_STORM,  // Every layout pin toggling at random, faster than anything can drain
+};
+
+struct Scenario {
+    const char *name;
+    Burst burst;
+    uint stall_us;
+    bool must_not_drop;  // With the default window
+};
+
+static const Scenario SCENARIOS[] = {
+    { "button buzz", BURST_BUTTON_BUZZ, 10000, true },
+    { "knob ringing", BURST_KNOB_RINGING, 60000, true },
+    { "storm", BURST_STORM, 20000, false },
+};
+
+struct PinChange {
+    uint64_t time;
+    uint8_t gpio;
+    bool level;
+};
+
+struct Stall {
+    std::vector<PinChange> changes;
+    int64_t knob_moves;  // True transitions, signed
+};
+
+struct Result {
+    uint64_t edges;
+    double edges_per_s;
+    uint32_t cancelled;
+    uint32_t dropped;
+    int64_t error;
+    bool in_sync;
+};
+
+static uint BUTTON_LEVEL = 0;
+static uint KNOB_PHASE = 0;
+
+static Stall make_stall(const Scenario &scenario, uint64_t start, std::mt19937 &rng) {
+    Stall stall { {}, 0 };
+    uint64_t time = start;
+    const uint64_t end = start + scenario.stall_us;
+    if (scenario.burst == BURST_BUTTON_BUZZ) {
+        std::uniform_int_distribution<uint> gap(1, 4);
+        for (time += gap(rng); time < end; time += gap(rng)) {
+            BUTTON_LEVEL ^= 1;
+            stall.changes.push_back(PinChange { time, BUTTON_0_GPIO, BUTTON_LEVEL != 0 });
+        }
+    }
+    else if (scenario.burst == BURST_KNOB_RINGING) {
+        // 300 RPM on 24 detents, 60 toggle pairs 1-3 us apart after each edge
+        const uint64_t gap_us = 60000000 / (300 * 24 * 4);
+        std::uniform_int_distribution<uint> ring_gap(1, 3);
+        for (time += gap_us; time + gap_us < end; time += gap_us) {
+            const uint previous = KNOB_PHASE;
+            KNOB_PHASE = (KNOB_PHASE + 1) % SIM_QUADRATURE_PHASES;
+            ++stall.knob_moves;
+            const EncoderLayout &encoder = CONTROLLER_LAYOUT.encoders[0];
+            const uint8_t gpio = sim_encoder_step_gpio(encoder, previous, KNOB_PHASE);
+            const bool level = ((sim_encoder_levels(encoder, KNOB_PHASE) >> gpio) & 1) != 0;
+            stall.changes.push_back(PinChange { time, gpio, level });
+            uint64_t ring_time = time;
+            for (uint ring = 0; ring < 60; ++ring) {
+                ring_time += ring_gap(rng);
+                stall.changes.push_back(PinChange { ring_time, gpio, !level });
+                ring_time += ring_gap(rng);
+                stall.changes.push_back(PinChange { ring_time, gpio, level });
+            }
+        }
+    }
+    else {
+        const uint8_t pins[3] = { (uint8_t)ROTARY_0_GPIO_0, (uint8_t)ROTARY_0_GPIO_1, (uint8_t)BUTTON_0_GPIO };
+        std::uniform_int_distribution<uint> which(0, 2);
+        uint32_t levels = gpio_get_all();
+        for (++time; time < end; ++time) {
+            const uint8_t gpio = pins[which(rng)];
+            levels ^= 1u << gpio;
+            stall.changes.push_back(PinChange { time, gpio, ((levels >> gpio) & 1) != 0 });
+        }
+    }
+    return stall;
+}
+
+static void run_main_loop(report &r, int64_t &position) {
+    Event batch[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events;
+    while ((num_events = pop_events(batch, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(batch[i]);
+        }
+    }
+    resync_dropped_inputs();
+    settle_buttons(time_us_32());
+    emit_rotary_encoder_rotations();
+    if (get_joystick()->has_changes()) {
+        const AxisValue before = r.axes[0];
+        get_joystick()->apply_to_report(r);
+        position += (int8_t)(r.axes[0] - before);
+    }
+    if (buttons_have_changes()) {
+        apply_buttons_to_report(r);
+    }
+}
+
+// Whether every handler agrees with the pins it watches
+static bool in_sync() {
+    const uint32_t levels = gpio_get_all();
+    RotaryEncoder &encoder = *get_rotary_encoder(0);
+    return !has_dropped_pins()
+        && encoder.get_decoder().get_state() == encoder.state_from_levels(levels)
+        && get_button(0)->is_pressed() == (((levels >> BUTTON_0_GPIO) & 1) != 0);
+}
+
+// One count per transition, through the default bank handler
+static void init_pipeline(uint32_t pair_window_us) {
+    sim_reset();
+    reset_event_queue();
+    init_joystick();
+    init_input_handlers();
+    set_rotary_encoder_consensus(1, 1);
+    set_joystick_sensitivity(1, 1);
+    set_event_pair_window_us(pair_window_us);
+    irq_set_exclusive_handler(IO_IRQ_BANK0, input_irq_handler);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    BUTTON_LEVEL = 0;
+    KNOB_PHASE = 0;
+}
+
+static Result play(const Scenario &scenario, uint repeats, uint32_t pair_window_us) {
+    init_pipeline(pair_window_us);
+    std::mt19937 rng(BENCH_SEED);
+    Result result { 0, 0, 0, 0, 0, true };
+    report r = {};
+    int64_t position = 0;
+    int64_t true_position = 0;
+    std::chrono::steady_clock::duration burst_time {};
+    for (uint repeat = 0; repeat < repeats; ++repeat) {
+        const Stall stall = make_stall(scenario, time_us_64(), rng);
+        const auto start = std::chrono::steady_clock::now();
+        for (const PinChange &change : stall.changes) {
+            sim_set_time_us(change.time);
+            sim_set_pin(change.gpio, change.level);
+        }
+        burst_time += std::chrono::steady_clock::now() - start;
+        result.edges += stall.changes.size();
+        true_position += stall.knob_moves;
+        for (uint loop = 0; loop < BENCH_CATCH_UP_US / BENCH_LOOP_US; ++loop) {
+            sim_advance_time_us(BENCH_LOOP_US);
+            run_main_loop(r, position);
+        }
+        result.in_sync &= in_sync();
+    }
+    const EventQueueStats stats = get_event_queue_stats();
+    result.edges_per_s = result.edges / std::chrono::duration<double>(burst_time).count();
+    result.cancelled = stats.cancelled_pairs;
+    result.dropped = stats.dropped_events;
+    result.error = position - true_position;
+    return result;
+}
+
+static void print_result(const char *name, uint32_t pair_window_us, const Result &result, const char *verdict) {
+    printf("%-14s %6u %10llu %9.1f %10u %9u %7lld  %s\n",
+        name,
+        pair_window_us,
+        (unsigned long long)result.edges,
+        result.edges_per_s / 1e6,
+        result.cancelled,
+        result.dropped,
+        (long long)result.error,
+        verdict);
+}
+
+int main(int argc, char **argv) {
+    const uint repeats = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_BENCH_REPEATS;
+    bool all_ok = true;
+
+    printf("%-14s %6s %10s %9s %10s %9s %7s\n", "scenario", "window", "edges", "Medges/s", "cancelled", "dropped", "error");
+    for (const Scenario &scenario : SCENARIOS) {
+        const Result cancelling = play(scenario, repeats, EVENT_DEFAULT_PAIR_WINDOW_US);
+        const Result plain = play(scenario, repeats, 0);
+        bool ok = cancelling.in_sync && plain.in_sync && cancelling.dropped <= plain.dropped;
+        if (scenario.must_not_drop) {
+            ok &= cancelling.dropped == 0 && cancelling.error == 0;
+        }
+        print_result(scenario.name, EVENT_DEFAULT_PAIR_WINDOW_US, cancelling, ok ? "ok" : "REGRESSED");
+        print_result("", 0, plain, plain.in_sync ? "" : "OUT OF SYNC");
+        all_ok &= ok;
+    }
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <stdlib.h>
+#include "sim.hpp"
+#include "buffer.hpp"
+#include "event.hpp"
+
+// Compares the lock-free SPSC ring against the original CircularBufferFIFOQueue
+// on the event queue's access pattern: a burst of pushes from the IRQ side,
+// then a full drain from the main loop.
+//
+// usage: bench_queue [events] [events per burst]
+
+#define DEFAULT_BENCH_EVENTS 20000000llu
+#define DEFAULT_BENCH_BURST 64
+
+static Event LEGACY_EVENT_BUFFER[EVENT_BUFFER_LENGTH];
+
+template <typename Fn>
+static double time_ns_per_event(uint64_t total_events, Fn &&run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return elapsed * 1e9 / total_events;
+}
+
+int main(int argc, char **argv) {
+    uint64_t total_events = argc > 1 ? strtoull(argv[1], nullptr, 10) : DEFAULT_BENCH_EVENTS;
+    uint burst = argc > 2 ? strtoul(argv[2], nullptr, 10) : DEFAULT_BENCH_BURST;
+    if (burst == 0 || burst > EVENT_BUFFER_LENGTH) {
+        panic("Burst length must be between 1 and %u\n", EVENT_BUFFER_LENGTH);
+    }
+
+    static CircularBufferFIFOQueue<Event> legacy_queue(LEGACY_EVENT_BUFFER, EVENT_BUFFER_LENGTH);
+    static SPSCRingQueue<Event, EVENT_BUFFER_LENGTH> ring_queue;
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint64_t checksums[3] = { 0, 0, 0 };
+
+    double legacy_ns = time_ns_per_event(total_events, [&]() {
+        for (uint64_t pushed = 0; pushed < total_events; pushed += burst) {
+            for (uint i = 0; i < burst; ++i) {
+                legacy_queue.push(Event(i & 31, GPIO_IRQ_EDGE_RISE));
+            }
+            std::optional<Event> maybe_event = legacy_queue.pop();
+            while (maybe_event.has_value()) {
+                checksums[0] += maybe_event.value().gpio();
+                maybe_event = legacy_queue.pop();
+            }
+        }
+    });
+
+    double ring_ns = time_ns_per_event(total_events, [&]() {
+        for (uint64_t pushed = 0; pushed < total_events; pushed += burst) {
+            for (uint i = 0; i < burst; ++i) {
+                ring_queue.push(Event(i & 31, GPIO_IRQ_EDGE_RISE));
+            }
+            std::optional<Event> maybe_event = ring_queue.pop();
+            while (maybe_event.has_value()) {
+                checksums[1] += maybe_event.value().gpio();
+                maybe_event = ring_queue.pop();
+            }
+        }
+    });
+
+    double ring_batch_ns = time_ns_per_event(total_events, [&]() {
+        for (uint64_t pushed = 0; pushed < total_events; pushed += burst) {
+            for (uint i = 0; i < burst; ++i) {
+                ring_queue.push(Event(i & 31, GPIO_IRQ_EDGE_RISE));
+            }
+            uint num_events = ring_queue.pop_batch(events, EVENT_DRAIN_BATCH_LENGTH);
+            while (num_events > 0) {
+                for (uint i = 0; i < num_events; ++i) {
+                    checksums[2] += events[i].gpio();
+                }
+                num_events = ring_queue.pop_batch(events, EVENT_DRAIN_BATCH_LENGTH);
+            }
+        }
+    });
+
+    if (checksums[0] != checksums[1] || checksums[1] != checksums[2]) {
+        panic("Queues disagree on drained events!\n");
+    }
+
+    printf("burst:                     %u\n", burst);
+    printf("CircularBufferFIFOQueue:   %.2f ns/event\n", legacy_ns);
+    printf("SPSCRingQueue pop:         %.2f ns/event\n", ring_ns);
+    printf("SPSCRingQueue pop_batch:   %.2f ns/event\n", ring_batch_ns);
+    return 0;
+}
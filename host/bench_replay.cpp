@@ -0,0 +1,95 @@
+#include <chrono>
+#include <stdlib.h>
+#include "sim.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "report_scheduler.hpp"
+#include "rotary_encoder.hpp"
+
+// Replays a synthetic knob spin through the same path main() runs on the board:
+// gpio callback -> record_event -> pop_event -> handlers -> apply_to_report
+// -> ReportScheduler, with every transfer completing immediately.
+//
+// usage: bench_replay [edges] [us between edges] [edges between button toggles, 0 = none]
+
+#define BUTTON_0_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+
+// Keep well inside EVENT_BUFFER_LENGTH so a batch never overflows the queue
+#define BENCH_BATCH_EDGES 1024
+
+#define BENCH_START_TIME_US 0xFFF00000llu
+
+#define DEFAULT_BENCH_EDGES 4000000llu
+#define DEFAULT_BENCH_EDGE_INTERVAL_US 1000llu
+#define DEFAULT_BENCH_BUTTON_PERIOD 64llu
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+int main(int argc, char **argv) {
+    uint64_t total_edges = argc > 1 ? strtoull(argv[1], nullptr, 10) : DEFAULT_BENCH_EDGES;
+    uint64_t edge_interval_us = argc > 2 ? strtoull(argv[2], nullptr, 10) : DEFAULT_BENCH_EDGE_INTERVAL_US;
+    uint64_t button_period = argc > 3 ? strtoull(argv[3], nullptr, 10) : DEFAULT_BENCH_BUTTON_PERIOD;
+
+    sim_reset();
+    // Start just short of the 32-bit timer wrap so the replay crosses it
+    sim_set_time_us(BENCH_START_TIME_US);
+    init_joystick();
+    init_input_handlers();
+    Joystick* stick = get_joystick();
+
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    ReportScheduler scheduler;
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint64_t total_events = 0;
+    uint64_t reports = 0;
+    uint phase = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t edge = 0; edge < total_edges;) {
+        for (uint batch = 0; batch < BENCH_BATCH_EDGES && edge < total_edges; ++batch, ++edge) {
+            sim_advance_time_us(edge_interval_us);
+            phase = (phase + SIM_QUADRATURE_PHASES - 1) % SIM_QUADRATURE_PHASES;  // Turning left
+            sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+            if (button_period != 0 && edge % button_period == 0) {
+                sim_set_pin(BUTTON_0_GPIO, !sim_get_pin(BUTTON_0_GPIO));
+            }
+        }
+
+        uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+        while (num_events > 0) {
+            for (uint i = 0; i < num_events; ++i) {
+                dispatch_event(events[i]);
+            }
+            total_events += num_events;
+            num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+        }
+        emit_rotary_encoder_rotations();
+        if (stick->has_changes()) {
+            stick->apply_to_report(scheduler.get_staged());
+        }
+        settle_buttons(time_us_32());
+        if (buttons_have_changes()) {
+            apply_buttons_to_report(scheduler.get_staged());
+        }
+        if (scheduler.begin_send() != nullptr) {
+            scheduler.complete_send();
+            ++reports;
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("events:        %llu\n", (unsigned long long)total_events);
+    printf("reports:       %llu\n", (unsigned long long)reports);
+    printf("rotation_x:    %u\n", scheduler.get_staged().axes[0]);
+    printf("elapsed:       %.3f s\n", elapsed);
+    printf("events/sec:    %.0f\n", total_events / elapsed);
+    printf("ns/event:      %.2f\n", elapsed * 1e9 / total_events);
+    return 0;
+}
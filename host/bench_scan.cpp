@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+#include "sim.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+#include "scanner.hpp"
+
+// Plays the same pin signals through both input front ends, the GPIO
+// interrupt on every edge and the timer driven scan (SCAN_INPUTS), and
+// compares what each costs in interrupt context:
+//
+//   irq/s      interrupts taken per second of signal
+//   events/s   events queued for the pin handlers per second of signal
+//   us/s       host time spent advancing the pins and the clock, which is
+//              the interrupt handlers plus a little sim overhead, per
+//              second of signal
+//   miscount   counts gained or lost, per 100 true transitions
+//
+// The scan takes 1e6 / SCAN_PERIOD_US interrupts a second whatever the pins
+// do, where the edge interrupt rate follows the noise. The host has no
+// interrupt entry cost, which on the M0+ is most of what a short handler
+// costs, so irq/s is the figure to read across to the board. The exit code is
+// non-zero if the scan rate moves, or the scan miscounts past a ceiling.
+//
+// usage: bench_scan [detents or presses per scenario]
+
+#define BUTTON_0_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+
+#define DEFAULT_BENCH_UNITS 10000
+#define BENCH_SEED 0x5eed
+#define BENCH_LOOP_US 1000  // How often the main loop drains and reads the output back
+#define BENCH_PAUSE_US 5000  // Still time after each run of the knob, where its position is checked
+#define BENCH_SCAN_RATE (1000000.0 / SCAN_PERIOD_US)
+
+struct Scenario {
+    const char *name;
+    bool button;
+    double rpm;  // Knob only
+    uint min_hold_us;  // Button only
+    uint max_hold_us;
+    uint max_rings;  // Extra toggle pairs after an edge
+    uint ring_start_us;  // First ringing gap is 1 to this many us
+    double ring_growth;  // Each ringing gap is this much longer than the last
+    double max_scan_miscount_percent;
+};
+
+// The ceilings sit just above what the scan scores in this tree. Ringing
+// that outlasts SCAN_DEBOUNCE_SAMPLES scans gets through the scan debouncer
+// and is left to the handlers, as it is in IRQ mode, so the ringing and
+// chatter scenarios miscount in both. A buzzing contact is the case the scan
+// is for: the edge interrupt rate is whatever the contact makes it.
+static const Scenario SCENARIOS[] = {
+    { "idle",           false, 0,   0,     0,      0,    0,   1.0, 0.0 },
+    { "knob clean",     false, 300, 0,     0,      0,    0,   1.0, 0.0 },
+    { "knob fast",      false, 600, 0,     0,      0,    0,   1.0, 0.0 },
+    { "knob bounce",    false, 300, 0,     0,      3,    20,  1.5, 0.0 },
+    { "knob ringing",   false, 120, 0,     0,      6,    100, 1.5, 30.0 },
+    { "button clean",   true,  0,   20000, 150000, 0,    0,   1.0, 0.0 },
+    { "button chatter", true,  0,   20000, 150000, 8,    600, 1.5, 270.0 },
+    { "button buzz",    true,  0,   20000, 150000, 2000, 8,   1.0, 77.0 },
+};
+
+struct PinChange {
+    uint64_t time;
+    uint8_t gpio;
+    bool level;
+};
+
+// Where the output should be by time
+struct Checkpoint {
+    uint64_t time;
+    int64_t value;
+};
+
+struct Signal {
+    std::vector<PinChange> changes;
+    std::vector<Checkpoint> checkpoints;
+    uint64_t true_transitions;
+    uint64_t duration;
+};
+
+struct Result {
+    double irq_per_s;
+    double events_per_s;
+    double us_per_s;
+    double miscount_percent;
+};
+
+static uint64_t IRQ_COUNT = 0;
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    ++IRQ_COUNT;
+    record_event(gpio, event_mask);
+}
+
+// Adds up to max_rings pairs of toggles after every edge, each gap growing by
+// ring_growth, cut short before the same pin's next edge
+static void add_ringing(Signal &signal, uint max_rings, uint ring_start_us, double ring_growth, std::mt19937 &rng) {
+    if (max_rings == 0) {
+        return;
+    }
+    std::uniform_int_distribution<uint> rings(0, max_rings);
+    std::uniform_int_distribution<uint> first_gap(1, ring_start_us);
+    const size_t num_edges = signal.changes.size();
+    std::vector<uint64_t> next_edge(num_edges, UINT64_MAX);
+    uint64_t next_by_pin[MAX_GPIO_PINS];
+    std::fill(next_by_pin, next_by_pin + MAX_GPIO_PINS, UINT64_MAX);
+    for (size_t i = num_edges; i-- > 0;) {
+        next_edge[i] = next_by_pin[signal.changes[i].gpio];
+        next_by_pin[signal.changes[i].gpio] = signal.changes[i].time;
+    }
+    for (size_t i = 0; i < num_edges; ++i) {
+        const PinChange edge = signal.changes[i];
+        double gap = first_gap(rng);
+        double time = edge.time;
+        for (uint ring = rings(rng); ring > 0; --ring) {
+            const double back = time + gap;
+            const double forth = back + gap * ring_growth;
+            if (forth + 1 >= next_edge[i]) {
+                break;
+            }
+            signal.changes.push_back(PinChange { (uint64_t)back, edge.gpio, !edge.level });
+            signal.changes.push_back(PinChange { (uint64_t)forth, edge.gpio, edge.level });
+            time = forth;
+            gap *= ring_growth * ring_growth;
+        }
+    }
+    std::stable_sort(signal.changes.begin(), signal.changes.end(), [](const PinChange &a, const PinChange &b) {
+        return a.time < b.time;
+    });
+}
+
+// Runs of a few detents to a few revolutions back and forth, with a pause
+// after each run where the position is checked
+static Signal make_knob_signal(const Scenario &scenario, uint detents, std::mt19937 &rng) {
+    Signal signal { {}, {}, 0, 0 };
+    const uint detents_per_rev = 24;
+    const double gap_us = 60e6 / (scenario.rpm * detents_per_rev * 4);
+    std::uniform_int_distribution<uint> run(4, 4 * detents_per_rev);
+    double time = gap_us;
+    int64_t position = 0;
+    const EncoderLayout &encoder = CONTROLLER_LAYOUT.encoders[0];
+    uint phase = 0;
+    int direction = 1;
+    uint remaining = run(rng);
+    for (uint detent = 0; detent < detents; ++detent) {
+        for (uint transition = 0; transition < 4; ++transition) {
+            const uint previous = phase;
+            phase = (phase + SIM_QUADRATURE_PHASES + direction) % SIM_QUADRATURE_PHASES;
+            time += gap_us;
+            const uint gpio = sim_encoder_step_gpio(encoder, previous, phase);
+            signal.changes.push_back(PinChange {
+                (uint64_t)time,
+                (uint8_t)gpio,
+                ((sim_encoder_levels(encoder, phase) >> gpio) & 1) != 0,
+            });
+            position += direction;
+            ++signal.true_transitions;
+        }
+        if (--remaining == 0 || detent + 1 == detents) {
+            signal.checkpoints.push_back(Checkpoint { (uint64_t)time + BENCH_PAUSE_US - BENCH_LOOP_US, position });
+            time += BENCH_PAUSE_US;
+            direction = -direction;
+            remaining = run(rng);
+        }
+    }
+    signal.duration = (uint64_t)time;
+    add_ringing(signal, scenario.max_rings, scenario.ring_start_us, scenario.ring_growth, rng);
+    return signal;
+}
+
+// The output is the number of button edges seen, checked halfway through
+// every hold
+static Signal make_button_signal(const Scenario &scenario, uint presses, std::mt19937 &rng) {
+    Signal signal { {}, {}, 0, 0 };
+    std::uniform_int_distribution<uint> hold(scenario.min_hold_us, scenario.max_hold_us);
+    uint64_t time = 0;
+    bool level = false;
+    for (uint edge = 0; edge < 2 * presses; ++edge) {
+        time += hold(rng);
+        level = !level;
+        signal.changes.push_back(PinChange { time, BUTTON_0_GPIO, level });
+        ++signal.true_transitions;
+        signal.checkpoints.push_back(Checkpoint { time + scenario.min_hold_us / 2, (int64_t)signal.true_transitions });
+    }
+    signal.duration = time + scenario.max_hold_us;
+    add_ringing(signal, scenario.max_rings, scenario.ring_start_us, scenario.ring_growth, rng);
+    return signal;
+}
+
+static Signal make_signal(const Scenario &scenario, uint units, std::mt19937 &rng) {
+    if (scenario.button) {
+        return make_button_signal(scenario, units, rng);
+    }
+    if (scenario.rpm == 0) {
+        return Signal { {}, {}, 0, (uint64_t)units * BENCH_LOOP_US };
+    }
+    return make_knob_signal(scenario, units, rng);
+}
+
+// Decodes everything queued so far and follows the output
+static void run_main_loop(report &r, int64_t &value, uint64_t &events) {
+    Event batch[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events;
+    while ((num_events = pop_events(batch, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(batch[i]);
+        }
+        events += num_events;
+    }
+    settle_buttons(time_us_32());
+    emit_rotary_encoder_rotations();
+    if (get_joystick()->has_changes()) {
+        const uint8_t before = r.axes[0];
+        get_joystick()->apply_to_report(r);
+        value += (int8_t)(r.axes[0] - before);
+    }
+    if (buttons_have_changes()) {
+        const uint16_t before = r.button_bitmap;
+        apply_buttons_to_report(r);
+        value += (before ^ r.button_bitmap) & 1;  // Button 0
+    }
+}
+
+// Starts the pipeline over in one mode, one axis count per transition
+static void init_pipeline(bool scan) {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    set_rotary_encoder_consensus(1, 1);
+    set_joystick_sensitivity(1, 1);
+    if (scan) {
+        init_input_scan(capture_input_state());
+    }
+    else {
+        gpio_set_irq_callback(&gpio_callback);
+        enable_input_irq();
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+}
+
+// Moves the clock and the pins through the signal, running the main loop
+// every BENCH_LOOP_US. Only moving the clock and the pins is timed, since
+// that is where the interrupts run.
+static Result play(const Signal &signal, bool scan) {
+    init_pipeline(scan);
+    IRQ_COUNT = 0;
+    report r = {};
+    int64_t value = 0;
+    uint64_t events = 0;
+    int64_t error = 0;
+    uint64_t miscounts = 0;
+    size_t next_change = 0;
+    size_t next_checkpoint = 0;
+    std::chrono::steady_clock::duration interrupt_time {};
+    for (uint64_t loop = BENCH_LOOP_US; loop <= signal.duration + BENCH_LOOP_US; loop += BENCH_LOOP_US) {
+        const auto start = std::chrono::steady_clock::now();
+        while (next_change < signal.changes.size() && signal.changes[next_change].time <= loop) {
+            const PinChange &change = signal.changes[next_change++];
+            sim_set_time_us(change.time);
+            sim_set_pin(change.gpio, change.level);
+        }
+        sim_set_time_us(loop);
+        interrupt_time += std::chrono::steady_clock::now() - start;
+        run_main_loop(r, value, events);
+        while (next_checkpoint < signal.checkpoints.size() && signal.checkpoints[next_checkpoint].time <= loop) {
+            // An error already made shifts what later checkpoints expect
+            const int64_t settled_error = value - signal.checkpoints[next_checkpoint++].value;
+            miscounts += settled_error > error ? settled_error - error : error - settled_error;
+            error = settled_error;
+        }
+    }
+    const double seconds = (signal.duration + BENCH_LOOP_US) / 1e6;
+    const uint64_t interrupts = scan ? get_scan_count() : IRQ_COUNT;
+    return Result {
+        interrupts / seconds,
+        events / seconds,
+        std::chrono::duration<double, std::micro>(interrupt_time).count() / seconds,
+        signal.true_transitions != 0 ? 100.0 * miscounts / signal.true_transitions : 0.0,
+    };
+}
+
+static void print_result(const char *name, const char *mode, const Result &result, const char *verdict) {
+    printf("%-16s %-5s %10.0f %10.0f %9.1f %9.3f%%  %s\n",
+        name,
+        mode,
+        result.irq_per_s,
+        result.events_per_s,
+        result.us_per_s,
+        result.miscount_percent,
+        verdict);
+}
+
+int main(int argc, char **argv) {
+    const uint units = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_BENCH_UNITS;
+    bool all_ok = true;
+
+    printf("%-16s %-5s %10s %10s %9s %10s\n", "scenario", "mode", "irq/s", "events/s", "us/s", "miscount");
+    for (const Scenario &scenario : SCENARIOS) {
+        std::mt19937 rng(BENCH_SEED);
+        const Signal signal = make_signal(scenario, units, rng);
+        print_result(scenario.name, "irq", play(signal, false), "");
+        const Result scan = play(signal, true);
+        // One interrupt per period, give or take the partial period at either end
+        const bool steady = scan.irq_per_s > BENCH_SCAN_RATE * 0.99 && scan.irq_per_s < BENCH_SCAN_RATE * 1.01;
+        const bool ok = steady && scan.miscount_percent <= scenario.max_scan_miscount_percent;
+        print_result("", "scan", scan, ok ? "ok" : "REGRESSED");
+        if (!ok) {
+            printf("%-16s %-5s %10.0f %10s %9s %9.3f%%  (ceilings)\n", "", "", BENCH_SCAN_RATE, "", "", scenario.max_scan_miscount_percent);
+        }
+        all_ok &= ok;
+    }
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+#include "sim.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+
+// Generates physical pin signals (quadrature at a given speed and detent
+// count with jitter, edges too close together for the ISR to tell apart, and
+// contacts that ring after every edge) and plays them through the ISR,
+// pin dispatch, RotaryEncoder::handle_event and the button path. Each
+// scenario is scored against the true knob position or button level:
+//
+//   ns/event   host time per ISR event, end to end
+//   miscount   counts gained or lost, per 100 true transitions
+//   latency    signal time from the edge that completes a detent (or
+//              moves a button) until the output reflects it
+//
+// Every scenario has a ceiling for each score and the exit code is non-zero
+// if any is exceeded, so ctest catches regressions in the decode path.
+// The signals are seeded, so miscount and latency are exact from run to run.
+//
+// usage: bench_signals [detents or presses per scenario] [max ns/event]
+
+#define BUTTON_0_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+
+#define DEFAULT_BENCH_UNITS 10000
+#define DEFAULT_BENCH_MAX_NS_PER_EVENT 2000.0
+#define BENCH_SEED 0x5eed
+#define BENCH_START_TIME_US 0xFF000000u  // The first scenarios cross the 32-bit timer wrap
+#define BENCH_ISR_LATENCY_US 2  // Edges this close together reach the ISR as one
+#define BENCH_POLL_US 100  // How often the main loop settles buttons while idle
+#define BENCH_SETTLE_WINDOW_US (4 * BUTTON_DEFAULT_LOCKOUT_US)  // Idle polling after this changes nothing
+#define BENCH_RING_GROWTH 1.5  // Each ringing gap is this much longer than the last
+
+struct EncoderScenario {
+    const char *name;
+    double rpm;
+    uint detents_per_rev;
+    double jitter;  // Each edge gap varies by up to this share of the nominal gap
+    uint missed_per_mille;  // Edges squeezed under BENCH_ISR_LATENCY_US after the previous one
+    uint max_rings;  // Extra toggle pairs after an edge
+    uint ring_start_us;  // First ringing gap is 1 to this many us
+    double max_miscount_percent;
+    double max_mean_latency_us;
+};
+
+struct ButtonScenario {
+    const char *name;
+    uint min_hold_us;
+    uint max_hold_us;
+    uint max_rings;
+    uint ring_start_us;
+    double max_miscount_percent;
+    double max_mean_latency_us;
+};
+
+// The ceilings sit just above what the decoder in this tree scores. Loosen
+// one only when a change is meant to trade it for something better.
+// Consensus drops the first transition after every reversal, hence the
+// floor of about 0.5%. Ringing that outlasts the edge gap or the button
+// lockout is there to show how badly that case goes, not to pass cleanly.
+static const EncoderScenario ENCODER_SCENARIOS[] = {
+    { "encoder slow",     60,  24,  0.0, 0,  0, 0,   0.6,  1.0 },
+    { "encoder fast",     600, 24,  0.0, 0,  0, 0,   0.6,  1.0 },
+    { "encoder jitter",   300, 24,  0.4, 0,  0, 0,   0.6,  1.0 },
+    { "spinner 600ppr",   900, 600, 0.2, 10, 0, 0,   2.5,  1.0 },
+    { "encoder bounce",   120, 24,  0.2, 0,  3, 20,  0.6,  1.0 },
+    { "encoder ringing",  120, 24,  0.2, 0,  6, 100, 40.0, 75.0 },
+};
+
+static const ButtonScenario BUTTON_SCENARIOS[] = {
+    { "button clean",    20000, 150000, 0, 0,   0.0,   1.0 },
+    { "button bounce",   20000, 150000, 4, 100, 0.05,  1.0 },
+    { "button chatter",  20000, 150000, 8, 600, 350.0, 120.0 },
+    { "button tapping",  6000,  15000,  4, 100, 0.05,  1.0 },
+};
+
+struct PinChange {
+    uint64_t time;  // Relative to the start of the scenario
+    uint8_t gpio;
+    bool level;
+};
+
+// The true value the output should reach at some moment: the knob position
+// in transitions at each detent, or the number of button edges so far. It
+// holds until the next true edge.
+struct Checkpoint {
+    uint64_t time;
+    uint64_t until;
+    int64_t value;
+};
+
+struct Signal {
+    std::vector<PinChange> changes;
+    std::vector<Checkpoint> checkpoints;
+    uint64_t true_transitions;
+};
+
+// What the output said after each pass of the main loop
+struct Observation {
+    uint64_t time;
+    int64_t value;
+};
+
+struct Score {
+    uint64_t events;
+    double ns_per_event;
+    double miscount_percent;
+    double mean_latency_us;
+    uint32_t max_latency_us;
+};
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+// Adds max_rings pairs of toggles after every edge, each gap growing by
+// BENCH_RING_GROWTH, cut short before the same pin's next edge
+static void add_ringing(Signal &signal, uint max_rings, uint ring_start_us, std::mt19937 &rng) {
+    if (max_rings == 0) {
+        return;
+    }
+    std::uniform_int_distribution<uint> rings(0, max_rings);
+    std::uniform_int_distribution<uint> first_gap(1, ring_start_us);
+    const size_t num_edges = signal.changes.size();
+    std::vector<uint64_t> next_edge(num_edges, UINT64_MAX);
+    uint64_t next_by_pin[MAX_GPIO_PINS];
+    std::fill(next_by_pin, next_by_pin + MAX_GPIO_PINS, UINT64_MAX);
+    for (size_t i = num_edges; i-- > 0;) {
+        next_edge[i] = next_by_pin[signal.changes[i].gpio];
+        next_by_pin[signal.changes[i].gpio] = signal.changes[i].time;
+    }
+    for (size_t i = 0; i < num_edges; ++i) {
+        const PinChange edge = signal.changes[i];
+        double gap = first_gap(rng);
+        double time = edge.time;
+        const uint toggles = 2 * rings(rng);
+        for (uint toggle = 0; toggle < toggles; toggle += 2) {
+            const double back = time + gap;
+            const double forth = back + gap * BENCH_RING_GROWTH;
+            if (forth + 1 >= next_edge[i]) {
+                break;
+            }
+            signal.changes.push_back(PinChange { (uint64_t)back, edge.gpio, !edge.level });
+            signal.changes.push_back(PinChange { (uint64_t)forth, edge.gpio, edge.level });
+            time = forth;
+            gap *= BENCH_RING_GROWTH * BENCH_RING_GROWTH;
+        }
+    }
+    std::stable_sort(signal.changes.begin(), signal.changes.end(), [](const PinChange &a, const PinChange &b) {
+        return a.time < b.time;
+    });
+}
+
+// A knob turning back and forth a few detents to a few revolutions at a
+// time, starting from wherever the pins are. Missed edges follow the
+// previous one within the ISR latency.
+static Signal make_encoder_signal(const EncoderScenario &scenario, uint detents, std::mt19937 &rng) {
+    Signal signal { {}, {}, 0 };
+    const double gap_us = 60e6 / (scenario.rpm * scenario.detents_per_rev * 4);
+    std::uniform_real_distribution<double> jitter(-scenario.jitter, scenario.jitter);
+    std::uniform_int_distribution<uint> run(4, 4 * scenario.detents_per_rev);
+    std::uniform_int_distribution<uint> per_mille(0, 999);
+    double time = gap_us;
+    int64_t position = 0;
+    const EncoderLayout &encoder = CONTROLLER_LAYOUT.encoders[0];
+    uint phase = sim_get_encoder_phase(encoder);
+    int direction = 1;
+    uint remaining = run(rng);
+    for (uint detent = 0; detent < detents; ++detent) {
+        if (remaining-- == 0) {
+            direction = -direction;
+            remaining = run(rng);
+        }
+        for (uint transition = 0; transition < 4; ++transition) {
+            const uint previous = phase;
+            phase = (phase + SIM_QUADRATURE_PHASES + direction) % SIM_QUADRATURE_PHASES;
+            if (per_mille(rng) < scenario.missed_per_mille) {
+                time += 1;
+            }
+            else {
+                time += std::max(gap_us * (1 + jitter(rng)), (double)BENCH_ISR_LATENCY_US + 1);
+            }
+            if (transition == 0 && !signal.checkpoints.empty()) {
+                signal.checkpoints.back().until = (uint64_t)time;
+            }
+            const uint gpio = sim_encoder_step_gpio(encoder, previous, phase);
+            signal.changes.push_back(PinChange {
+                (uint64_t)time,
+                (uint8_t)gpio,
+                ((sim_encoder_levels(encoder, phase) >> gpio) & 1) != 0,
+            });
+            position += direction;
+            ++signal.true_transitions;
+        }
+        signal.checkpoints.push_back(Checkpoint { (uint64_t)time, UINT64_MAX, position });
+    }
+    add_ringing(signal, scenario.max_rings, scenario.ring_start_us, rng);
+    return signal;
+}
+
+static Signal make_button_signal(const ButtonScenario &scenario, uint presses, std::mt19937 &rng) {
+    Signal signal { {}, {}, 0 };
+    std::uniform_int_distribution<uint> hold(scenario.min_hold_us, scenario.max_hold_us);
+    uint64_t time = 0;
+    bool level = false;
+    for (uint edge = 0; edge < 2 * presses; ++edge) {
+        time += hold(rng);
+        level = !level;
+        signal.changes.push_back(PinChange { time, BUTTON_0_GPIO, level });
+        ++signal.true_transitions;
+        if (!signal.checkpoints.empty()) {
+            signal.checkpoints.back().until = time;
+        }
+        signal.checkpoints.push_back(Checkpoint { time, UINT64_MAX, (int64_t)signal.true_transitions });
+    }
+    add_ringing(signal, scenario.max_rings, scenario.ring_start_us, rng);
+    return signal;
+}
+
+struct Pipeline {
+    Joystick* stick;
+    report r;
+};
+
+// Handlers can not be unregistered, so every scenario shares one pipeline
+static Pipeline init_pipeline() {
+    sim_reset();
+    sim_set_time_us(BENCH_START_TIME_US);
+    init_joystick();
+    init_input_handlers();
+    Joystick* stick = get_joystick();
+    // One axis count per tick, so the axis is the decoded position
+    stick->set_sensitivity(1, 1);
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    return Pipeline { stick, report {} };
+}
+
+// One pass of the main loop: decode, settle, and read the output back
+static void run_main_loop(Pipeline &pipeline, Event* events, int64_t &value, uint64_t &total_events) {
+    uint num_events;
+    while ((num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(events[i]);
+        }
+        total_events += num_events;
+    }
+    settle_buttons(time_us_32());
+    emit_rotary_encoder_rotations();
+    if (pipeline.stick->has_changes()) {
+        const uint8_t before = pipeline.r.axes[0];
+        pipeline.stick->apply_to_report(pipeline.r);
+        value += (int8_t)(pipeline.r.axes[0] - before);
+    }
+    if (buttons_have_changes()) {
+        const uint16_t before = pipeline.r.button_bitmap;
+        apply_buttons_to_report(pipeline.r);
+        value += (before ^ pipeline.r.button_bitmap) & 1;  // Button 0
+    }
+}
+
+// Plays the signal through the pipeline. Changes closer together than the
+// ISR latency are applied at once and raise a single event, as on the board.
+// Idle polling is left out of the timing, the events are what is measured.
+// Only changes of the output are kept.
+static std::vector<Observation> play(Pipeline &pipeline, const Signal &signal, bool poll, uint64_t &total_events, double &elapsed) {
+    const uint64_t base = time_us_64();
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    std::vector<Observation> observations;
+    int64_t value = 0;
+    uint64_t now = 0;
+    uint64_t last_change = 0;
+    total_events = 0;
+    elapsed = 0;
+    const PinChange* changes = signal.changes.data();
+    const size_t num_changes = signal.changes.size();
+    auto observe = [&]() {
+        if (observations.empty() || observations.back().value != value) {
+            observations.push_back(Observation { now, value });
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_changes;) {
+        const uint64_t group_start = changes[i].time;
+        if (poll && group_start - now > BENCH_POLL_US && now - last_change < BENCH_SETTLE_WINDOW_US) {
+            elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            while (group_start - now > BENCH_POLL_US && now - last_change < BENCH_SETTLE_WINDOW_US) {
+                now += BENCH_POLL_US;
+                sim_set_time_us(base + now);
+                run_main_loop(pipeline, events, value, total_events);
+                observe();
+            }
+            start = std::chrono::steady_clock::now();
+        }
+        size_t end = i + 1;
+        while (end < num_changes && changes[end].time - group_start <= BENCH_ISR_LATENCY_US) {
+            ++end;
+        }
+        now = changes[end - 1].time;
+        last_change = now;
+        sim_set_time_us(base + now);
+        if (end == i + 1) {
+            sim_set_pin(changes[i].gpio, changes[i].level);
+        }
+        else {
+            irq_set_enabled(IO_IRQ_BANK0, false);
+            for (size_t change = i; change < end; ++change) {
+                sim_set_pin(changes[change].gpio, changes[change].level);
+            }
+            irq_set_enabled(IO_IRQ_BANK0, true);
+            const PinChange &last = changes[end - 1];
+            record_event(last.gpio, last.level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL);
+        }
+        run_main_loop(pipeline, events, value, total_events);
+        observe();
+        i = end;
+    }
+    elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Let the last lockout run out
+    now += BENCH_SETTLE_WINDOW_US;
+    sim_set_time_us(base + now);
+    run_main_loop(pipeline, events, value, total_events);
+    observe();
+    return observations;
+}
+
+// Each checkpoint owns the time up to the next true edge. Errors already made
+// shift what later checkpoints expect, so one lost count is counted once.
+static Score score(const Signal &signal, const std::vector<Observation> &observations, uint64_t events, double elapsed) {
+    Score result { events, events != 0 ? elapsed * 1e9 / events : 0.0, 0.0, 0.0, 0 };
+    int64_t error = 0;
+    uint64_t miscounts = 0;
+    uint64_t latency_sum = 0;
+    uint64_t latency_samples = 0;
+    size_t next = 0;
+    int64_t value = 0;
+    for (size_t checkpoint = 0; checkpoint < signal.checkpoints.size(); ++checkpoint) {
+        const Checkpoint &current = signal.checkpoints[checkpoint];
+        const uint64_t until = current.until;
+        const int64_t target = current.value + error;
+        bool reached = false;
+        while (next < observations.size() && observations[next].time < current.time) {
+            value = observations[next++].value;
+        }
+        if (value == target) {
+            reached = true;  // Already there, the detent needed no decoding
+            ++latency_samples;
+        }
+        while (next < observations.size() && observations[next].time < until) {
+            value = observations[next].value;
+            if (!reached && value == target) {
+                reached = true;
+                const uint32_t latency = (uint32_t)(observations[next].time - current.time);
+                latency_sum += latency;
+                ++latency_samples;
+                result.max_latency_us = std::max(result.max_latency_us, latency);
+            }
+            ++next;
+        }
+        const int64_t settled_error = value - current.value;
+        miscounts += settled_error > error ? settled_error - error : error - settled_error;
+        error = settled_error;
+    }
+    result.miscount_percent = signal.true_transitions != 0 ? 100.0 * miscounts / signal.true_transitions : 0.0;
+    result.mean_latency_us = latency_samples != 0 ? (double)latency_sum / latency_samples : 0.0;
+    return result;
+}
+
+static bool report_score(const char *name, const Score &result, double max_miscount_percent, double max_mean_latency_us, double max_ns_per_event) {
+    const bool ok = result.miscount_percent <= max_miscount_percent
+        && result.mean_latency_us <= max_mean_latency_us
+        && result.ns_per_event <= max_ns_per_event;
+    printf("%-16s %9llu %9.1f %9.3f%% %9.1f %9u  %s\n",
+        name,
+        (unsigned long long)result.events,
+        result.ns_per_event,
+        result.miscount_percent,
+        result.mean_latency_us,
+        result.max_latency_us,
+        ok ? "ok" : "REGRESSED");
+    if (!ok) {
+        printf("%-16s %9s %9.1f %9.3f%% %9.1f  (ceilings)\n", "", "", max_ns_per_event, max_miscount_percent, max_mean_latency_us);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const uint units = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_BENCH_UNITS;
+    const double max_ns_per_event = argc > 2 ? strtod(argv[2], nullptr) : DEFAULT_BENCH_MAX_NS_PER_EVENT;
+    bool all_ok = true;
+    Pipeline pipeline = init_pipeline();
+
+    printf("%-16s %9s %9s %10s %9s %9s\n", "scenario", "events", "ns/event", "miscount", "mean us", "max us");
+    for (const EncoderScenario &scenario : ENCODER_SCENARIOS) {
+        std::mt19937 rng(BENCH_SEED);
+        const Signal signal = make_encoder_signal(scenario, units, rng);
+        uint64_t events;
+        double elapsed;
+        const std::vector<Observation> observations = play(pipeline, signal, false, events, elapsed);
+        all_ok &= report_score(scenario.name, score(signal, observations, events, elapsed),
+            scenario.max_miscount_percent, scenario.max_mean_latency_us, max_ns_per_event);
+    }
+    for (const ButtonScenario &scenario : BUTTON_SCENARIOS) {
+        std::mt19937 rng(BENCH_SEED);
+        const Signal signal = make_button_signal(scenario, units, rng);
+        uint64_t events;
+        double elapsed;
+        const std::vector<Observation> observations = play(pipeline, signal, true, events, elapsed);
+        all_ok &= report_score(scenario.name, score(signal, observations, events, elapsed),
+            scenario.max_miscount_percent, scenario.max_mean_latency_us, max_ns_per_event);
+    }
+    return all_ok ? 0 : 1;
+}
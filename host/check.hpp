@@ -0,0 +1,20 @@
+#pragma once
+#include <stdio.h>
+
+// Shared by the host tests. check() reports each failed condition and lets
+// the test carry on, finish_checks() prints the verdict and returns main()'s
+// exit code.
+
+inline bool CHECKS_OK = true;
+
+inline void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("  FAILED: %s\n", what);
+        CHECKS_OK = false;
+    }
+}
+
+inline int finish_checks() {
+    printf("%s\n", CHECKS_OK ? "ok" : "FAILED");
+    return CHECKS_OK ? 0 : 1;
+}
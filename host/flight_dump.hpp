@@ -0,0 +1,109 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "flight_recorder.hpp"
+#include "rotary_encoder.hpp"
+
+// Reading flight recorder dumps back and replaying them through whatever
+// QuadratureDecoder this tree builds, shared by flight_replay and its test.
+
+// Any layout's encoder index fits the dispatch table, whatever cabinet the
+// dump came from
+#define FLIGHT_DUMP_MAX_ENCODERS (MAX_PIN_HANDLER_INDEX + 1)
+
+struct FlightDump {
+    uint8_t debounce_count;
+    uint8_t consensus_count;
+    uint32_t total_records;
+    std::vector<FlightRecord> records;
+
+    // The ring overwrote the start, so the decoders' consensus windows were
+    // already partly filled when the dump begins
+    bool wrapped() const {
+        return total_records > records.size();
+    }
+};
+
+// What the decoder in this build makes of one recorded edge
+struct FlightReplay {
+    RotaryEncoderDecision decision;
+    RotaryEncoderState after;
+    bool warming_up;  // The window still lacks transitions the recording had
+};
+
+// Pages back to back, as read from the device. Stops at the page with no
+// records or at the end of the bytes. Returns false on a version mismatch,
+// a torn page or an encoder index out of range.
+inline bool parse_flight_dump(const uint8_t* bytes, size_t len, FlightDump &dump) {
+    dump.records.clear();
+    bool first = true;
+    for (size_t offset = 0; offset < len; offset += sizeof(FlightRecorderPage)) {
+        if (len - offset < sizeof(FlightRecorderPage)) {
+            return false;
+        }
+        FlightRecorderPage page;
+        memcpy(&page, bytes + offset, sizeof(page));
+        if (page.version != FLIGHT_RECORDER_VERSION || page.num_records > FLIGHT_RECORDER_PAGE_RECORDS) {
+            return false;
+        }
+        if (first) {
+            dump.debounce_count = page.debounce_count;
+            dump.consensus_count = page.consensus_count;
+            dump.total_records = page.total_records;
+            first = false;
+        }
+        if (page.num_records == 0) {
+            break;
+        }
+        for (uint i = 0; i < page.num_records; ++i) {
+            if (page.records[i].encoder >= FLIGHT_DUMP_MAX_ENCODERS) {
+                return false;
+            }
+            dump.records.push_back(page.records[i]);
+        }
+    }
+    return !first;
+}
+
+inline bool load_flight_dump(const char* path, FlightDump &dump) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + read);
+    }
+    fclose(file);
+    return parse_flight_dump(bytes.data(), bytes.size(), dump);
+}
+
+// Each encoder's decoder starts from the state before its first record.
+// Edges are fed exactly as the ISR sampled them.
+inline std::vector<FlightReplay> replay_flight_dump(const FlightDump &dump, uint debounce_count, uint consensus_count) {
+    QuadratureDecoder decoders[FLIGHT_DUMP_MAX_ENCODERS];
+    bool started[FLIGHT_DUMP_MAX_ENCODERS] = {};
+    uint transitions_seen[FLIGHT_DUMP_MAX_ENCODERS] = {};
+    for (QuadratureDecoder &decoder : decoders) {
+        decoder.set_consensus(debounce_count, consensus_count);
+    }
+    std::vector<FlightReplay> replays;
+    replays.reserve(dump.records.size());
+    for (const FlightRecord &record : dump.records) {
+        QuadratureDecoder &decoder = decoders[record.encoder];
+        if (!started[record.encoder]) {
+            decoder.reset(flight_record_state_before(record));
+            started[record.encoder] = true;
+        }
+        const bool warming_up = dump.wrapped() && transitions_seen[record.encoder] < dump.debounce_count;
+        const RotaryEncoderDecision decision = decoder.decode(flight_record_state_after(record), record.time);
+        if (decision == DECODE_NO_CONSENSUS || decision == DECODE_ROTATE_LEFT || decision == DECODE_ROTATE_RIGHT) {
+            ++transitions_seen[record.encoder];
+        }
+        replays.push_back(FlightReplay { decision, decoder.get_state(), warming_up });
+    }
+    return replays;
+}
@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include "flight_dump.hpp"
+
+// Feeds a flight recorder dump back through the QuadratureDecoder in this
+// tree and lists every edge with what the device decided then and what
+// this build decides now. Build with a changed decoder to see what the
+// change would have done to a recorded glitch.
+//
+// The exit code is non-zero if any decision differs, not counting edges
+// decoded before a wrapped dump's consensus windows had filled.
+//
+// usage: flight_replay <dump> [debounce count] [consensus count]
+// The counts default to the ones the device was using.
+
+static const char* DECISION_NAMES[] = {
+    "unchanged",
+    "invalid",
+    "no consensus",
+    "left",
+    "right",
+};
+
+static const char* decision_name(uint decision) {
+    return decision < sizeof(DECISION_NAMES) / sizeof(DECISION_NAMES[0]) ? DECISION_NAMES[decision] : "?";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <dump> [debounce count] [consensus count]\n", argv[0]);
+        return 2;
+    }
+    FlightDump dump;
+    if (!load_flight_dump(argv[1], dump)) {
+        printf("%s is not a version %u flight recorder dump\n", argv[1], FLIGHT_RECORDER_VERSION);
+        return 2;
+    }
+    const uint debounce_count = argc > 2 ? strtoul(argv[2], nullptr, 0) : dump.debounce_count;
+    const uint consensus_count = argc > 3 ? strtoul(argv[3], nullptr, 0) : dump.consensus_count;
+    if (!QuadratureDecoder::is_valid_consensus(debounce_count, consensus_count)) {
+        printf("%u of %u is not a valid consensus\n", consensus_count, debounce_count);
+        return 2;
+    }
+
+    printf("%zu of %u records, recorded with %u of %u, replayed with %u of %u\n",
+        dump.records.size(), dump.total_records,
+        dump.consensus_count, dump.debounce_count, consensus_count, debounce_count);
+    printf("%10s %3s %4s %4s %7s %-13s %s\n", "+us", "enc", "gpio", "edge", "states", "recorded", "replayed");
+
+    const std::vector<FlightReplay> replays = replay_flight_dump(dump, debounce_count, consensus_count);
+    uint differences = 0;
+    uint32_t last_time = dump.records.empty() ? 0 : dump.records[0].time;
+    for (size_t i = 0; i < dump.records.size(); ++i) {
+        const FlightRecord &record = dump.records[i];
+        const FlightReplay &replay = replays[i];
+        const bool differs = replay.decision != record.decision || replay.after != flight_record_state_after(record);
+        if (differs && !replay.warming_up) {
+            ++differences;
+        }
+        const uint32_t edges = (record.gpio_and_edges >> EVENT_EDGE_SHIFT) & EVENT_EDGE_BITS;
+        printf("%10u %3u %4u %4s %3u->%-3u %-13s %s%s\n",
+            record.time - last_time,
+            record.encoder,
+            record.gpio_and_edges & EVENT_GPIO_BITS,
+            edges == GPIO_IRQ_EDGE_RISE ? "rise" : edges == GPIO_IRQ_EDGE_FALL ? "fall" : "both",
+            flight_record_state_before(record),
+            flight_record_state_after(record),
+            decision_name(record.decision),
+            decision_name(replay.decision),
+            differs ? (replay.warming_up ? "  (warming up)" : "  <<") : "");
+        last_time = record.time;
+    }
+    printf("%u decision(s) differ\n", differences);
+    return differences == 0 ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+// Host-side stand-in for hardware/irq.h. Raise handlers through sim.hpp.
+#include "pico/stdlib.h"
+
+typedef void (*irq_handler_t)();
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
@@ -0,0 +1,61 @@
+#pragma once
+// Host-side stand-in for hardware/pio.h. The state machines run the loaded
+// instruction words for real against the virtual pins, see sim.hpp.
+#include "pico/stdlib.h"
+
+#define NUM_PIOS 2
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+
+struct pio_hw {
+    uint index;
+};
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t SIM_PIO_HW[NUM_PIOS];
+#define pio0 (&SIM_PIO_HW[0])
+#define pio1 (&SIM_PIO_HW[1])
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;  // -1 for anywhere
+} pio_program_t;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+typedef struct {
+    uint wrap_target;
+    uint wrap;
+    uint in_base;
+    bool in_shift_right;
+    bool out_shift_right;
+    enum pio_fifo_join join;
+    float clkdiv;
+} pio_sm_config;
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+
+pio_sm_config pio_get_default_sm_config();
+void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap);
+void sm_config_set_in_pins(pio_sm_config *c, uint in_base);
+void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold);
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold);
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join);
+void sm_config_set_clkdiv(pio_sm_config *c, float div);
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
@@ -0,0 +1,21 @@
+#pragma once
+// Host-side stand-in for hardware/structs/iobank0.h, just the interrupt
+// registers. The sim latches edges into ints and treats every bit written to
+// intr during the handler as cleared, see sim.hpp.
+#include "pico/stdlib.h"
+
+typedef struct {
+    volatile uint32_t inte[4];
+    volatile uint32_t intf[4];
+    volatile uint32_t ints[4];
+} io_irq_ctrl_hw_t;
+
+typedef struct {
+    volatile uint32_t intr[4];
+    io_irq_ctrl_hw_t proc0_irq_ctrl;
+    io_irq_ctrl_hw_t proc1_irq_ctrl;
+} iobank0_hw_t;
+
+extern iobank0_hw_t SIM_IO_BANK0;
+
+#define io_bank0_hw (&SIM_IO_BANK0)
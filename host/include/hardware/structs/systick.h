@@ -0,0 +1,18 @@
+#pragma once
+// Host-side stand-in for hardware/structs/systick.h. Nothing counts the
+// virtual cycles down; tests set cvr themselves.
+#include "pico/stdlib.h"
+
+#define M0PLUS_SYST_CSR_ENABLE_BITS 0x00000001u
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS 0x00000004u
+
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t rvr;
+    volatile uint32_t cvr;
+    volatile uint32_t calib;
+} systick_hw_t;
+
+extern systick_hw_t SIM_SYSTICK;
+
+#define systick_hw (&SIM_SYSTICK)
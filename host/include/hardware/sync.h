@@ -0,0 +1,7 @@
+#pragma once
+// Host-side stand-in for hardware/sync.h. Nothing runs alongside the sim, so
+// WFE returns at once; sim.hpp counts how often it was reached.
+#include "pico/stdlib.h"
+
+void __wfe();
+void __sev();
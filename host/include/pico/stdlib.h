@@ -0,0 +1,84 @@
+#pragma once
+// Host-side stand-in for the slice of the Pico SDK the firmware uses.
+// Pins and the clock are virtual; drive them through sim.hpp.
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define PICO_DEFAULT_LED_PIN 25  // As on the Pico board
+
+#define __not_in_flash_func(func_name) func_name
+
+#define GPIO_IN false
+#define GPIO_OUT true
+
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+enum gpio_function {
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+#define PWM_IRQ_WRAP 4
+#define IO_IRQ_BANK0 13
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+typedef struct alarm_pool alarm_pool_t;
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+    int64_t delay_us;
+    alarm_pool_t *pool;
+    int32_t alarm_id;
+    repeating_timer_callback_t callback;
+    void *user_data;
+};
+
+[[noreturn]] void panic(const char *fmt, ...);
+
+// The sim runs everything as core 0
+static inline uint get_core_num() {
+    return 0;
+}
+
+// Pins only change when the caller says so, so there is nothing to hold off
+static inline uint32_t save_and_disable_interrupts() {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+uint64_t time_us_64();
+uint32_t time_us_32();
+void sleep_ms(uint32_t ms);
+
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_pull_down(uint gpio);
+void gpio_pull_up(uint gpio);
+bool gpio_get(uint gpio);
+uint32_t gpio_get_all();
+void gpio_put(uint gpio, bool value);
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+void irq_set_enabled(uint num, bool enabled);
+
+// Repeating timers fire as the virtual clock moves past them, see sim.hpp
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers);
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+bool stdio_init_all();
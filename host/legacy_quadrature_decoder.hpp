@@ -0,0 +1,133 @@
+#pragma once
+#include <optional>
+#include "buffer.hpp"
+#include "rotary_encoder.hpp"
+
+#define LEGACY_MIN_US_DIFF_TO_SEND 800u
+
+// Legacy decoders worked from which edge fired rather than from pin levels
+enum RotaryEncoderEvent {
+    LEFT_EDGE_FALL = 0,
+    LEFT_EDGE_RISE = 1,
+    RIGHT_EDGE_FALL = 2,
+    RIGHT_EDGE_RISE = 3,
+};
+
+// The switch-based decoder RotaryEncoder used before the transition table,
+// kept verbatim (minus the Joystick calls) so benchmarks can check the table
+// decoder against it.
+class LegacyQuadratureDecoder {
+private:
+    std::optional<RotaryEncoderTransition> transition_slots[ROTARY_ENCODER_DEBOUNCE_COUNT];
+    CircularOverflowBuffer<RotaryEncoderTransition> transition_buffer;
+    RotaryEncoderState last_state;
+    uint counts[2];
+    uint32_t last_state_update;
+    bool last_read_ok;
+
+public:
+    LegacyQuadratureDecoder():
+        transition_buffer(transition_slots, ROTARY_ENCODER_DEBOUNCE_COUNT),
+        last_state(UNKNOWN),
+        counts {0, 0},
+        last_state_update(0),
+        last_read_ok(true)
+    { }
+
+    void reset(RotaryEncoderState state) {
+        last_state = state;
+    }
+
+    // Out of line, like QuadratureDecoder::decode, so both pay the same call cost
+    [[gnu::noinline]] RotaryEncoderDecision decode(RotaryEncoderEvent event, uint32_t now) {
+        std::optional<RotaryEncoderState> next_state = std::nullopt;
+        std::optional<RotaryEncoderTransition> transition = std::nullopt;
+        uint32_t diff = now - last_state_update;
+        bool fast = diff < LEGACY_MIN_US_DIFF_TO_SEND;
+        switch (last_state) {
+            case BOTH_DOWN:
+                switch (event) {
+                    case LEFT_EDGE_RISE:
+                        next_state.emplace(LEFT_UP);
+                        transition.emplace(ROTATE_LEFT);
+                        break;
+                    case RIGHT_EDGE_RISE:
+                        next_state.emplace(RIGHT_UP);
+                        transition.emplace(ROTATE_RIGHT);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case LEFT_UP:
+                switch (event) {
+                    case LEFT_EDGE_FALL:
+                        next_state.emplace(BOTH_DOWN);
+                        transition.emplace(ROTATE_RIGHT);
+                        break;
+                    case RIGHT_EDGE_RISE:
+                        next_state.emplace(BOTH_UP);
+                        transition.emplace(ROTATE_LEFT);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case RIGHT_UP:
+                switch (event) {
+                    case LEFT_EDGE_RISE:
+                        next_state.emplace(BOTH_UP);
+                        transition.emplace(ROTATE_RIGHT);
+                        break;
+                    case RIGHT_EDGE_FALL:
+                        next_state.emplace(BOTH_DOWN);
+                        transition.emplace(ROTATE_LEFT);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case BOTH_UP:
+                switch (event) {
+                    case LEFT_EDGE_FALL:
+                        next_state.emplace(RIGHT_UP);
+                        transition.emplace(ROTATE_LEFT);
+                        break;
+                    case RIGHT_EDGE_FALL:
+                        next_state.emplace(LEFT_UP);
+                        transition.emplace(ROTATE_RIGHT);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            [[unlikely]] case UNKNOWN:
+                panic("Rotary encoder last known state is uninitialized!\n");
+        }
+
+        if (next_state.has_value()) [[likely]] {
+            last_state_update = now;
+            last_state = next_state.value();
+            if (!last_read_ok) {
+                last_read_ok = true;
+                return DECODE_UNCHANGED;  // Skipped after an error, nothing counted
+            }
+            if (fast) {
+                return DECODE_UNCHANGED;  // Dropped as too fast, nothing counted
+            }
+            std::optional<RotaryEncoderTransition> popped = transition_buffer.push(transition.value());
+            ++counts[transition.value()];
+            if (popped.has_value()) {
+                --counts[popped.value()];
+            }
+            if (counts[transition.value()] >= ROTARY_ENCODER_CONSENSUS_COUNT) {
+                return transition.value() == ROTATE_LEFT ? DECODE_ROTATE_LEFT : DECODE_ROTATE_RIGHT;
+            }
+            return DECODE_NO_CONSENSUS;
+        }
+        else [[unlikely]] {
+            last_read_ok = false;
+            return DECODE_INVALID;
+        }
+    }
+};
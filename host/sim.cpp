@@ -0,0 +1,437 @@
+#include <chrono>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "sim.hpp"
+
+static uint64_t SIM_TIME_US = 0;
+static bool SIM_WALL_CLOCK = false;
+static std::chrono::steady_clock::time_point SIM_WALL_CLOCK_START;
+static uint32_t SIM_PIN_LEVELS = 0;  // Bit n is the level of pin n
+static uint32_t SIM_PIN_IRQ_MASKS[SIM_GPIO_PINS];
+static gpio_irq_callback_t SIM_IRQ_CALLBACK = nullptr;
+static bool SIM_IRQ_ENABLED = false;
+static irq_handler_t SIM_BANK_IRQ_HANDLER = nullptr;  // Raw IO_IRQ_BANK0 handler, in place of the callback
+static bool SIM_IN_BANK_IRQ = false;
+static int SIM_PIN_AFTER_SAMPLE = -1;  // Moves when the bank handler next reads the pins
+static bool SIM_LEVEL_AFTER_SAMPLE = false;
+static enum gpio_function SIM_PIN_FUNCTIONS[SIM_GPIO_PINS];
+static uint16_t SIM_PWM_LEVELS[NUM_PWM_SLICES][2];
+static bool SIM_PWM_RUNNING[NUM_PWM_SLICES];
+static uint32_t SIM_PWM_IRQ_MASK = 0;  // Bit n = slice n raises PWM_IRQ_WRAP
+static uint32_t SIM_PWM_IRQ_STATUS = 0;
+static irq_handler_t SIM_PWM_IRQ_HANDLER = nullptr;
+static bool SIM_PWM_IRQ_ENABLED = false;
+static repeating_timer_t* SIM_TIMER = nullptr;
+static uint64_t SIM_TIMER_DUE = 0;
+static uint64_t SIM_WFE_COUNT = 0;
+static uint64_t SIM_SEV_COUNT = 0;
+
+iobank0_hw_t SIM_IO_BANK0;
+systick_hw_t SIM_SYSTICK;
+
+struct alarm_pool {
+    uint max_timers;
+};
+
+static alarm_pool_t SIM_ALARM_POOL = { 1 };
+
+static void check_pin(uint gpio) {
+    if (gpio >= SIM_GPIO_PINS) [[unlikely]] {
+        panic("gpio pin %u does not exist!\n", gpio);
+    }
+}
+
+void sim_reset() {
+    SIM_TIME_US = 0;
+    SIM_WALL_CLOCK = false;
+    SIM_PIN_LEVELS = 0;
+    for (uint pin = 0; pin < SIM_GPIO_PINS; ++pin) {
+        SIM_PIN_IRQ_MASKS[pin] = 0;
+    }
+    SIM_IRQ_CALLBACK = nullptr;
+    SIM_IRQ_ENABLED = false;
+    SIM_BANK_IRQ_HANDLER = nullptr;
+    SIM_IN_BANK_IRQ = false;
+    SIM_PIN_AFTER_SAMPLE = -1;
+    SIM_IO_BANK0 = iobank0_hw_t {};
+    SIM_SYSTICK = systick_hw_t {};
+    for (uint pin = 0; pin < SIM_GPIO_PINS; ++pin) {
+        SIM_PIN_FUNCTIONS[pin] = GPIO_FUNC_NULL;
+    }
+    for (uint slice = 0; slice < NUM_PWM_SLICES; ++slice) {
+        SIM_PWM_LEVELS[slice][0] = 0;
+        SIM_PWM_LEVELS[slice][1] = 0;
+        SIM_PWM_RUNNING[slice] = false;
+    }
+    SIM_PWM_IRQ_MASK = 0;
+    SIM_PWM_IRQ_STATUS = 0;
+    SIM_PWM_IRQ_HANDLER = nullptr;
+    SIM_PWM_IRQ_ENABLED = false;
+    SIM_TIMER = nullptr;
+    SIM_WFE_COUNT = 0;
+    SIM_SEV_COUNT = 0;
+    sim_pio_reset();
+}
+
+static uint64_t sim_timer_period(const repeating_timer_t *timer) {
+    return timer->delay_us < 0 ? -timer->delay_us : timer->delay_us;
+}
+
+// Runs the repeating timer for every period up to time, then lands on it
+static void sim_run_timers_until(uint64_t time) {
+    while (SIM_TIMER != nullptr && SIM_TIMER_DUE <= time) {
+        SIM_TIME_US = SIM_TIMER_DUE;
+        repeating_timer_t *timer = SIM_TIMER;
+        if (!timer->callback(timer)) {
+            SIM_TIMER = nullptr;
+            break;
+        }
+        SIM_TIMER_DUE += sim_timer_period(timer);
+    }
+    SIM_TIME_US = time;
+}
+
+void sim_set_time_us(uint64_t time) {
+    if (time < SIM_TIME_US) {
+        // Back in time, the timer restarts its period from there
+        SIM_TIME_US = time;
+        if (SIM_TIMER != nullptr) {
+            SIM_TIMER_DUE = time + sim_timer_period(SIM_TIMER);
+        }
+        return;
+    }
+    sim_run_timers_until(time);
+}
+
+void sim_advance_time_us(uint64_t delta) {
+    sim_run_timers_until(SIM_TIME_US + delta);
+}
+
+void sim_use_wall_clock() {
+    SIM_WALL_CLOCK_START = std::chrono::steady_clock::now();
+    SIM_WALL_CLOCK = true;
+}
+
+void sim_set_pin(uint gpio, bool level) {
+    check_pin(gpio);
+    sim_set_pins(1u << gpio, level ? 1u << gpio : 0);
+}
+
+// Runs the raw handler over everything latched and clears what it
+// acknowledged. Edges that latched while it ran and were not acknowledged
+// run it again, as the board would re-enter.
+static void sim_raise_bank_irq() {
+    io_irq_ctrl_hw_t &ctrl = SIM_IO_BANK0.proc0_irq_ctrl;
+    bool pending = true;
+    while (pending) {
+        uint32_t at_entry[4];
+        for (uint reg = 0; reg < 4; ++reg) {
+            at_entry[reg] = ctrl.ints[reg];
+            SIM_IO_BANK0.intr[reg] = 0;
+        }
+        SIM_IN_BANK_IRQ = true;
+        SIM_BANK_IRQ_HANDLER();
+        SIM_IN_BANK_IRQ = false;
+        pending = false;
+        for (uint reg = 0; reg < 4; ++reg) {
+            ctrl.ints[reg] &= ~SIM_IO_BANK0.intr[reg];
+            SIM_IO_BANK0.intr[reg] = 0;
+            if ((ctrl.ints[reg] & at_entry[reg]) != 0) [[unlikely]] {
+                panic("IO_IRQ_BANK0 handler left edges %08x pending in register %u!\n", (uint)(ctrl.ints[reg] & at_entry[reg]), reg);
+            }
+            pending = pending || ctrl.ints[reg] != 0;
+        }
+    }
+}
+
+void sim_set_pin_after_next_sample(uint gpio, bool level) {
+    check_pin(gpio);
+    SIM_PIN_AFTER_SAMPLE = gpio;
+    SIM_LEVEL_AFTER_SAMPLE = level;
+}
+
+// Every changed pin raises its own callback, after all of them have moved.
+// A raw bank handler runs once for all of them instead.
+void sim_set_pins(uint32_t mask, uint32_t levels) {
+    const uint32_t changed = (SIM_PIN_LEVELS ^ levels) & mask;
+    if (changed == 0) {
+        return;
+    }
+    SIM_PIN_LEVELS ^= changed;
+    bool latched = false;
+    for (uint32_t pins = changed; pins != 0; pins &= pins - 1) {
+        const uint gpio = __builtin_ctz(pins);
+        check_pin(gpio);
+        const uint32_t edge = (levels >> gpio) & 1 ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+        if (!SIM_IRQ_ENABLED || !(SIM_PIN_IRQ_MASKS[gpio] & edge)) {
+            continue;
+        }
+        if (SIM_BANK_IRQ_HANDLER != nullptr) {
+            SIM_IO_BANK0.proc0_irq_ctrl.ints[gpio / 8] |= edge << (4 * (gpio % 8));
+            latched = true;
+        }
+        else if (SIM_IRQ_CALLBACK != nullptr) {
+            SIM_IRQ_CALLBACK(gpio, edge);
+        }
+    }
+    if (latched && !SIM_IN_BANK_IRQ) {
+        sim_raise_bank_irq();
+    }
+    sim_pio_run(SIM_PIO_STEPS_PER_CHANGE);
+}
+
+// Left/right pin levels of each phase
+static const bool SIM_QUADRATURE_LEVELS[SIM_QUADRATURE_PHASES][2] = {
+    { false, false },
+    { false, true },
+    { true, true },
+    { true, false },
+};
+
+// Only the encoder's own two pins, at their bit positions
+uint32_t sim_encoder_levels(const EncoderLayout &encoder, uint phase) {
+    const bool* levels = SIM_QUADRATURE_LEVELS[phase % SIM_QUADRATURE_PHASES];
+    return ((uint32_t)levels[0] << encoder.gpio_left) | ((uint32_t)levels[1] << encoder.gpio_right);
+}
+
+// The pin that moves between two neighbouring phases
+uint sim_encoder_step_gpio(const EncoderLayout &encoder, uint from_phase, uint to_phase) {
+    const uint32_t moved = sim_encoder_levels(encoder, from_phase) ^ sim_encoder_levels(encoder, to_phase);
+    if (__builtin_popcount(moved) != 1) [[unlikely]] {
+        panic("Quadrature phases %u and %u are not neighbours!\n", from_phase, to_phase);
+    }
+    return __builtin_ctz(moved);
+}
+
+void sim_set_encoder_phase(const EncoderLayout &encoder, uint phase) {
+    const uint32_t pins = (1u << encoder.gpio_left) | (1u << encoder.gpio_right);
+    sim_set_pins(pins, sim_encoder_levels(encoder, phase));
+}
+
+uint sim_get_encoder_phase(const EncoderLayout &encoder) {
+    const uint32_t pins = (1u << encoder.gpio_left) | (1u << encoder.gpio_right);
+    uint phase = 0;
+    while (sim_encoder_levels(encoder, phase) != (SIM_PIN_LEVELS & pins)) {
+        ++phase;
+    }
+    return phase;
+}
+
+bool sim_get_pin(uint gpio) {
+    check_pin(gpio);
+    return (SIM_PIN_LEVELS >> gpio) & 1;
+}
+
+enum gpio_function sim_get_pin_function(uint gpio) {
+    check_pin(gpio);
+    return SIM_PIN_FUNCTIONS[gpio];
+}
+
+void __wfe() {
+    ++SIM_WFE_COUNT;
+}
+
+void __sev() {
+    ++SIM_SEV_COUNT;
+}
+
+uint64_t sim_wfe_count() {
+    return SIM_WFE_COUNT;
+}
+
+uint64_t sim_sev_count() {
+    return SIM_SEV_COUNT;
+}
+
+void sim_pwm_wrap() {
+    for (uint slice = 0; slice < NUM_PWM_SLICES; ++slice) {
+        if (SIM_PWM_RUNNING[slice]) {
+            SIM_PWM_IRQ_STATUS |= 1u << slice;
+        }
+    }
+    if (sim_pwm_irq_pending() && SIM_PWM_IRQ_HANDLER != nullptr) {
+        SIM_PWM_IRQ_HANDLER();
+    }
+}
+
+uint16_t sim_get_pwm_level(uint gpio) {
+    check_pin(gpio);
+    return SIM_PWM_LEVELS[pwm_gpio_to_slice_num(gpio)][pwm_gpio_to_channel(gpio)];
+}
+
+bool sim_pwm_irq_pending() {
+    return SIM_PWM_IRQ_ENABLED && (SIM_PWM_IRQ_STATUS & SIM_PWM_IRQ_MASK) != 0;
+}
+
+void panic(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fputs("*** PANIC ***\n", stderr);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    abort();
+}
+
+uint64_t time_us_64() {
+    if (SIM_WALL_CLOCK) {
+        auto elapsed = std::chrono::steady_clock::now() - SIM_WALL_CLOCK_START;
+        return SIM_TIME_US + std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+    return SIM_TIME_US;
+}
+
+uint32_t time_us_32() {
+    return (uint32_t)time_us_64();
+}
+
+void sleep_ms(uint32_t ms) {
+    sim_run_timers_until(SIM_TIME_US + ms * 1000llu);
+}
+
+void gpio_init(uint gpio) {
+    check_pin(gpio);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    check_pin(gpio);
+    SIM_PIN_FUNCTIONS[gpio] = fn;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    check_pin(gpio);
+    (void)out;
+}
+
+void gpio_pull_down(uint gpio) {
+    check_pin(gpio);
+}
+
+void gpio_pull_up(uint gpio) {
+    check_pin(gpio);
+}
+
+bool gpio_get(uint gpio) {
+    return sim_get_pin(gpio);
+}
+
+uint32_t gpio_get_all() {
+    const uint32_t levels = SIM_PIN_LEVELS;
+    if (SIM_IN_BANK_IRQ && SIM_PIN_AFTER_SAMPLE >= 0) {
+        const uint gpio = SIM_PIN_AFTER_SAMPLE;
+        SIM_PIN_AFTER_SAMPLE = -1;
+        sim_set_pin(gpio, SIM_LEVEL_AFTER_SAMPLE);
+    }
+    return levels;
+}
+
+void gpio_put(uint gpio, bool value) {
+    check_pin(gpio);
+    SIM_PIN_LEVELS = value ? (SIM_PIN_LEVELS | (1u << gpio)) : (SIM_PIN_LEVELS & ~(1u << gpio));
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    check_pin(gpio);
+    if (enabled) {
+        SIM_PIN_IRQ_MASKS[gpio] |= event_mask;
+    }
+    else {
+        SIM_PIN_IRQ_MASKS[gpio] &= ~event_mask;
+    }
+    uint32_t inte = SIM_IO_BANK0.proc0_irq_ctrl.inte[gpio / 8] & ~(0xFu << (4 * (gpio % 8)));
+    SIM_IO_BANK0.proc0_irq_ctrl.inte[gpio / 8] = inte | (SIM_PIN_IRQ_MASKS[gpio] << (4 * (gpio % 8)));
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    SIM_IRQ_CALLBACK = callback;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num == IO_IRQ_BANK0) {
+        SIM_IRQ_ENABLED = enabled;
+    }
+    else if (num == PWM_IRQ_WRAP) {
+        SIM_PWM_IRQ_ENABLED = enabled;
+    }
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    if (num == IO_IRQ_BANK0) {
+        SIM_BANK_IRQ_HANDLER = handler;
+    }
+    else if (num == PWM_IRQ_WRAP) {
+        SIM_PWM_IRQ_HANDLER = handler;
+    }
+}
+
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers) {
+    if (max_timers != 1) [[unlikely]] {
+        panic("The sim runs one repeating timer at a time!\n");
+    }
+    return &SIM_ALARM_POOL;
+}
+
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+    if (SIM_TIMER != nullptr || delay_us == 0) {
+        return false;
+    }
+    *out = repeating_timer { delay_us, pool, 1, callback, user_data };
+    SIM_TIMER = out;
+    SIM_TIMER_DUE = SIM_TIME_US + sim_timer_period(out);
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+    if (SIM_TIMER != timer) {
+        return false;
+    }
+    SIM_TIMER = nullptr;
+    return true;
+}
+
+static void check_slice(uint slice_num) {
+    if (slice_num >= NUM_PWM_SLICES) [[unlikely]] {
+        panic("PWM slice %u does not exist!\n", slice_num);
+    }
+}
+
+pwm_config pwm_get_default_config() {
+    return pwm_config { 1.f, 0xffff };
+}
+
+void pwm_config_set_clkdiv(pwm_config *c, float div) {
+    c->clkdiv = div;
+}
+
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) {
+    c->wrap = wrap;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {
+    check_slice(slice_num);
+    (void)c;
+    SIM_PWM_RUNNING[slice_num] = start;
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+    check_slice(slice_num);
+    SIM_PWM_LEVELS[slice_num][chan & 1] = level;
+}
+
+void pwm_clear_irq(uint slice_num) {
+    check_slice(slice_num);
+    SIM_PWM_IRQ_STATUS &= ~(1u << slice_num);
+}
+
+void pwm_set_irq_enabled(uint slice_num, bool enabled) {
+    check_slice(slice_num);
+    if (enabled) {
+        SIM_PWM_IRQ_MASK |= 1u << slice_num;
+    }
+    else {
+        SIM_PWM_IRQ_MASK &= ~(1u << slice_num);
+    }
+}
+
+bool stdio_init_all() {
+    return true;
+}
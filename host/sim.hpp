@@ -0,0 +1,73 @@
+#pragma once
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+#include "hardware/structs/iobank0.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+#include "layout.hpp"
+
+#define SIM_GPIO_PINS 30
+#define SIM_PIO_STEPS_PER_CHANGE 32  // Several passes of any sampling loop, so the PIO never misses a level
+
+// Virtual hardware behind the host HAL shim. Time only moves when told to,
+// and setting a pin level raises the registered GPIO callback exactly like
+// IO_IRQ_BANK0 would on the board.
+//
+// A handler installed on IO_IRQ_BANK0 with irq_set_exclusive_handler takes
+// the place of the callback. Each pin change latches its enabled edges into
+// proc0_irq_ctrl.ints, and the handler runs once per sim_set_pins() call
+// with every edge from it pending. Bits it writes to intr are cleared, and
+// any edge it leaves pending panics, since the board would re-enter forever.
+// Edges that latch while it runs are pending straight away, and run it again
+// afterwards unless it acknowledged them. sim_set_pin_after_next_sample()
+// moves a pin just after the handler's next gpio_get_all(), for an edge that
+// lands mid-handler.
+//
+// Enabled PIO state machines run SIM_PIO_STEPS_PER_CHANGE instructions after
+// every pin change, which stands in for them sampling far faster than the
+// pins move. sim_set_pins() changes several pins between two samples.
+//
+// A repeating timer fires at every multiple of its period the clock moves
+// past, with the clock set to that moment, one timer at a time.
+//
+// __wfe() and __sev() return at once and are only counted, so a test sees
+// whether the loop would have slept.
+//
+// sim_use_wall_clock() makes the clock follow real time instead, for
+// benchmarks that run the pipeline on several threads. The pins are then
+// only safe to drive from one thread, which plays the interrupt.
+
+void sim_reset();
+void sim_set_time_us(uint64_t time);
+void sim_advance_time_us(uint64_t delta);
+void sim_use_wall_clock();
+void sim_set_pin(uint gpio, bool level);
+void sim_set_pins(uint32_t mask, uint32_t levels);
+void sim_set_pin_after_next_sample(uint gpio, bool level);
+bool sim_get_pin(uint gpio);
+enum gpio_function sim_get_pin_function(uint gpio);
+
+// Quadrature on one encoder's pins, right pin leading when turning right.
+// Turning right steps to the next phase, mod SIM_QUADRATURE_PHASES, and
+// neighbouring phases differ in one pin. sim_set_encoder_phase() moves both
+// pins in one sim_set_pins() call.
+#define SIM_QUADRATURE_PHASES 4
+uint32_t sim_encoder_levels(const EncoderLayout &encoder, uint phase);
+uint sim_encoder_step_gpio(const EncoderLayout &encoder, uint from_phase, uint to_phase);
+void sim_set_encoder_phase(const EncoderLayout &encoder, uint phase);
+uint sim_get_encoder_phase(const EncoderLayout &encoder);
+
+// Every running PWM slice wraps at once. Raises PWM_IRQ_WRAP if it is
+// enabled and any slice has its wrap interrupt enabled.
+uint64_t sim_wfe_count();
+uint64_t sim_sev_count();
+
+void sim_pwm_wrap();
+uint16_t sim_get_pwm_level(uint gpio);
+bool sim_pwm_irq_pending();
+
+void sim_pio_reset();
+void sim_pio_run(uint steps);
+uint64_t sim_pio_steps();
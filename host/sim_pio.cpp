@@ -0,0 +1,361 @@
+#include "sim.hpp"
+
+// A PIO instruction interpreter, enough of one for the programs in this
+// tree: jmp, in, out, push and mov, no delays or side-set. Anything else
+// panics rather than running wrong.
+
+#define SIM_PIO_RX_FIFO_DEPTH 4
+#define SIM_PIO_JOINED_FIFO_DEPTH 8
+#define SIM_PIO_MAX_BLOCKING_STEPS 1024
+
+enum SimPioOpcode {
+    PIO_OP_JMP = 0,
+    PIO_OP_WAIT,
+    PIO_OP_IN,
+    PIO_OP_OUT,
+    PIO_OP_PUSH_PULL,
+    PIO_OP_MOV,
+    PIO_OP_IRQ,
+    PIO_OP_SET,
+};
+
+struct SimStateMachine {
+    bool claimed;
+    bool enabled;
+    uint pc;
+    uint32_t x;
+    uint32_t y;
+    uint32_t isr;
+    uint32_t osr;
+    uint isr_count;  // Bits shifted in since the last push
+    uint osr_count;  // Bits shifted out since the last pull
+    pio_sm_config config;
+    uint32_t fifo[SIM_PIO_JOINED_FIFO_DEPTH];
+    uint fifo_len;
+    uint fifo_read;
+};
+
+struct SimPio {
+    uint16_t instructions[PIO_INSTRUCTION_COUNT];
+    uint32_t used;  // Bit n = instruction n belongs to a program
+    SimStateMachine sms[NUM_PIO_STATE_MACHINES];
+};
+
+pio_hw_t SIM_PIO_HW[NUM_PIOS] = { { 0 }, { 1 } };
+static SimPio SIM_PIOS[NUM_PIOS];
+static uint64_t SIM_PIO_STEPS = 0;
+
+static SimStateMachine& sim_sm(PIO pio, uint sm) {
+    if (pio->index >= NUM_PIOS || sm >= NUM_PIO_STATE_MACHINES) [[unlikely]] {
+        panic("PIO %u state machine %u does not exist!\n", pio->index, sm);
+    }
+    return SIM_PIOS[pio->index].sms[sm];
+}
+
+static uint fifo_depth(const SimStateMachine &machine) {
+    return machine.config.join == PIO_FIFO_JOIN_RX ? SIM_PIO_JOINED_FIFO_DEPTH : SIM_PIO_RX_FIFO_DEPTH;
+}
+
+static uint32_t bit_mask(uint bits) {
+    return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+}
+
+static uint32_t reverse_bits(uint32_t data) {
+    uint32_t reversed = 0;
+    for (uint bit = 0; bit < 32; ++bit) {
+        reversed = (reversed << 1) | ((data >> bit) & 1);
+    }
+    return reversed;
+}
+
+static uint32_t read_source(SimStateMachine &machine, uint source) {
+    switch (source) {
+        case 0:
+            return gpio_get_all() >> machine.config.in_base;
+        case 1:
+            return machine.x;
+        case 2:
+            return machine.y;
+        case 3:
+            return 0;
+        case 6:
+            return machine.isr;
+        case 7:
+            return machine.osr;
+        default:
+            panic("PIO source %u is not modelled!\n", source);
+    }
+}
+
+static void shift_in(SimStateMachine &machine, uint32_t data, uint bits) {
+    data &= bit_mask(bits);
+    if (machine.config.in_shift_right) {
+        machine.isr = bits >= 32 ? data : (machine.isr >> bits) | (data << (32 - bits));
+    }
+    else {
+        machine.isr = bits >= 32 ? data : (machine.isr << bits) | data;
+    }
+    machine.isr_count = machine.isr_count + bits > 32 ? 32 : machine.isr_count + bits;
+}
+
+static uint32_t shift_out(SimStateMachine &machine, uint bits) {
+    uint32_t data;
+    if (machine.config.out_shift_right) {
+        data = machine.osr & bit_mask(bits);
+        machine.osr = bits >= 32 ? 0 : machine.osr >> bits;
+    }
+    else {
+        data = bits >= 32 ? machine.osr : machine.osr >> (32 - bits);
+        machine.osr = bits >= 32 ? 0 : machine.osr << bits;
+    }
+    machine.osr_count = machine.osr_count + bits > 32 ? 32 : machine.osr_count + bits;
+    return data;
+}
+
+// Runs one instruction, moving next if it jumps. False if it stalled.
+static bool execute(SimStateMachine &machine, uint16_t instruction, uint &next) {
+    const uint opcode = instruction >> 13;
+    const uint delay_side_set = (instruction >> 8) & 0x1F;
+    const uint arg1 = (instruction >> 5) & 0x7;
+    const uint arg2 = instruction & 0x1F;
+    const uint bits = arg2 == 0 ? 32 : arg2;
+    if (delay_side_set != 0) [[unlikely]] {
+        panic("PIO delay and side-set are not modelled!\n");
+    }
+    switch (opcode) {
+        case PIO_OP_JMP: {
+            bool taken;
+            switch (arg1) {
+                case 0: taken = true; break;
+                case 1: taken = machine.x == 0; break;
+                case 2: taken = machine.x-- != 0; break;
+                case 3: taken = machine.y == 0; break;
+                case 4: taken = machine.y-- != 0; break;
+                case 5: taken = machine.x != machine.y; break;
+                case 7: taken = machine.osr_count < 32; break;
+                default: panic("PIO jmp condition %u is not modelled!\n", arg1);
+            }
+            if (taken) {
+                next = arg2;
+            }
+            break;
+        }
+        case PIO_OP_IN:
+            shift_in(machine, read_source(machine, arg1), bits);
+            break;
+        case PIO_OP_OUT: {
+            const uint32_t data = shift_out(machine, bits);
+            switch (arg1) {
+                case 1: machine.x = data; break;
+                case 2: machine.y = data; break;
+                case 3: break;
+                case 5: next = data & (PIO_INSTRUCTION_COUNT - 1); break;
+                case 6: machine.isr = data; machine.isr_count = bits; break;
+                default: panic("PIO out destination %u is not modelled!\n", arg1);
+            }
+            break;
+        }
+        case PIO_OP_PUSH_PULL: {
+            if (instruction & 0x80) {
+                panic("PIO pull is not modelled!\n");
+            }
+            const bool block = instruction & 0x20;
+            if (machine.fifo_len < fifo_depth(machine)) {
+                machine.fifo[(machine.fifo_read + machine.fifo_len) % SIM_PIO_JOINED_FIFO_DEPTH] = machine.isr;
+                ++machine.fifo_len;
+            }
+            else if (block) {
+                return false;
+            }
+            // A non-blocking push into a full FIFO is dropped, and the ISR still clears
+            machine.isr = 0;
+            machine.isr_count = 0;
+            break;
+        }
+        case PIO_OP_MOV: {
+            uint32_t data = read_source(machine, arg2 & 0x7);
+            const uint op = (instruction >> 3) & 0x3;
+            if (op == 1) {
+                data = ~data;
+            }
+            else if (op == 2) {
+                data = reverse_bits(data);
+            }
+            switch (arg1) {
+                case 1: machine.x = data; break;
+                case 2: machine.y = data; break;
+                case 5: next = data & (PIO_INSTRUCTION_COUNT - 1); break;
+                case 6: machine.isr = data; machine.isr_count = 0; break;
+                case 7: machine.osr = data; machine.osr_count = 0; break;
+                default: panic("PIO mov destination %u is not modelled!\n", arg1);
+            }
+            break;
+        }
+        default:
+            panic("PIO opcode %u is not modelled!\n", opcode);
+    }
+    return true;
+}
+
+// Runs the instruction at pc. A stalled one runs again on the next step.
+static void step(SimPio &pio, SimStateMachine &machine) {
+    uint next = machine.pc == machine.config.wrap ? machine.config.wrap_target : machine.pc + 1;
+    ++SIM_PIO_STEPS;
+    if (execute(machine, pio.instructions[machine.pc], next)) {
+        machine.pc = next;
+    }
+}
+
+void sim_pio_reset() {
+    for (SimPio &pio : SIM_PIOS) {
+        pio = SimPio {};
+    }
+    SIM_PIO_STEPS = 0;
+}
+
+void sim_pio_run(uint steps) {
+    for (SimPio &pio : SIM_PIOS) {
+        for (SimStateMachine &machine : pio.sms) {
+            if (machine.enabled) {
+                for (uint i = 0; i < steps; ++i) {
+                    step(pio, machine);
+                }
+            }
+        }
+    }
+}
+
+uint64_t sim_pio_steps() {
+    return SIM_PIO_STEPS;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+    const SimPio &sim = SIM_PIOS[pio->index];
+    const uint origin = program->origin < 0 ? 0 : program->origin;
+    const uint32_t wanted = bit_mask(program->length) << origin;
+    return origin + program->length <= PIO_INSTRUCTION_COUNT && (sim.used & wanted) == 0;
+}
+
+// Fixed origins only, which is all this tree loads
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    if (!pio_can_add_program(pio, program) || program->origin < 0) [[unlikely]] {
+        panic("No room for the PIO program!\n");
+    }
+    SimPio &sim = SIM_PIOS[pio->index];
+    for (uint i = 0; i < program->length; ++i) {
+        sim.instructions[program->origin + i] = program->instructions[i];
+    }
+    sim.used |= bit_mask(program->length) << program->origin;
+    return program->origin;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; ++sm) {
+        SimStateMachine &machine = sim_sm(pio, sm);
+        if (!machine.claimed) {
+            machine.claimed = true;
+            return sm;
+        }
+    }
+    if (required) {
+        panic("No free PIO state machine!\n");
+    }
+    return -1;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+    gpio_set_function(pin, pio->index == 0 ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1);
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    sim_sm(pio, sm);
+    if (is_out || pin_base + pin_count > SIM_GPIO_PINS) [[unlikely]] {
+        panic("Only PIO inputs are modelled!\n");
+    }
+}
+
+pio_sm_config pio_get_default_sm_config() {
+    return pio_sm_config { 0, PIO_INSTRUCTION_COUNT - 1, 0, true, true, PIO_FIFO_JOIN_NONE, 1.f };
+}
+
+void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {
+    c->wrap_target = wrap_target;
+    c->wrap = wrap;
+}
+
+void sm_config_set_in_pins(pio_sm_config *c, uint in_base) {
+    c->in_base = in_base;
+}
+
+void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold) {
+    if (autopush) [[unlikely]] {
+        panic("PIO autopush is not modelled!\n");
+    }
+    (void)push_threshold;
+    c->in_shift_right = shift_right;
+}
+
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+    if (autopull) [[unlikely]] {
+        panic("PIO autopull is not modelled!\n");
+    }
+    (void)pull_threshold;
+    c->out_shift_right = shift_right;
+}
+
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {
+    c->join = join;
+}
+
+// The model runs on steps rather than cycles, so the divider is only kept
+void sm_config_set_clkdiv(pio_sm_config *c, float div) {
+    c->clkdiv = div;
+}
+
+// As on the chip, X, Y and the shift registers keep whatever they held
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    SimStateMachine &machine = sim_sm(pio, sm);
+    machine.enabled = false;
+    machine.config = *config;
+    machine.pc = initial_pc;
+    machine.isr_count = 0;
+    machine.osr_count = 32;
+    machine.fifo_len = 0;
+    machine.fifo_read = 0;
+    return 0;
+}
+
+// Runs at once, enabled or not, as a write to SMx_INSTR does. The pc only
+// moves if the instruction jumps.
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+    SimStateMachine &machine = sim_sm(pio, sm);
+    uint next = machine.pc;
+    if (!execute(machine, (uint16_t)instr, next)) [[unlikely]] {
+        panic("PIO state machine %u stalled on an executed instruction!\n", sm);
+    }
+    machine.pc = next;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    sim_sm(pio, sm).enabled = enabled;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) {
+    return sim_sm(pio, sm).fifo_len;
+}
+
+// The state machine keeps running while the CPU waits, so an empty FIFO
+// steps it until it pushes
+uint32_t pio_sm_get_blocking(PIO pio, uint sm) {
+    SimStateMachine &machine = sim_sm(pio, sm);
+    for (uint i = 0; machine.fifo_len == 0; ++i) {
+        if (!machine.enabled || i >= SIM_PIO_MAX_BLOCKING_STEPS) [[unlikely]] {
+            panic("PIO state machine %u never pushes!\n", sm);
+        }
+        step(SIM_PIOS[pio->index], machine);
+    }
+    const uint32_t value = machine.fifo[machine.fifo_read];
+    machine.fifo_read = (machine.fifo_read + 1) % SIM_PIO_JOINED_FIFO_DEPTH;
+    --machine.fifo_len;
+    return value;
+}
@@ -0,0 +1,99 @@
+#include "sim.hpp"
+#include "check.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "report_descriptor.hpp"
+#include "rotary_encoder.hpp"
+
+// Built with TWO_KNOB_LAYOUT and HIGH_RESOLUTION_AXES. Turns both knobs and
+// checks that each one only moves its own axis, that the 16-bit axes carry
+// the fraction of a count the 8-bit ones drop, that sensitivities can step
+// by less than a count, and that the report and its descriptor grew to
+// match.
+
+#define TEST_SLOW_GAP_US 50000  // The bottom of the acceleration curve
+#define TEST_FAST_GAP_US 2100  // Bucket 8, where a step is not a whole count
+#define TEST_FAST_BUCKET (TEST_FAST_GAP_US >> JOYSTICK_ACCELERATION_BUCKET_SHIFT)
+
+static_assert(CONTROLLER_NUM_ENCODERS == 2 && CONTROLLER_NUM_AXES == 2, "Needs TWO_KNOB_LAYOUT");
+static_assert(sizeof(AxisValue) == 2, "Needs HIGH_RESOLUTION_AXES");
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+// Moves one knob one transition, then runs the main loop once
+static void step(uint encoder, int direction, uint phases[], uint32_t gap_us, report &r) {
+    const EncoderLayout &layout = CONTROLLER_LAYOUT.encoders[encoder];
+    phases[encoder] = (phases[encoder] + SIM_QUADRATURE_PHASES + direction) % SIM_QUADRATURE_PHASES;
+    sim_advance_time_us(gap_us);
+    sim_set_encoder_phase(layout, phases[encoder]);
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events;
+    while ((num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(events[i]);
+        }
+    }
+    emit_rotary_encoder_rotations();
+    if (get_joystick()->has_changes()) {
+        get_joystick()->apply_to_report(r);
+    }
+}
+
+int main() {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    // Every transition counts at once
+    set_rotary_encoder_consensus(1, 1);
+
+    printf("report\n");
+    check(GAMEPAD_REPORT_LENGTH == 6, "Bitmap and two 16-bit axes");
+    const DescriptorBytes<GAMEPAD_REPORT_DESCRIPTOR_LENGTH + 1> expected =
+        make_gamepad_report_descriptor<GAMEPAD_REPORT_DESCRIPTOR_LENGTH + 1>(CONTROLLER_LAYOUT, GAMEPAD_REPORT_ID, 16, false);
+    bool descriptor_matches = expected.length == GAMEPAD_REPORT_DESCRIPTOR_LENGTH;
+    for (size_t i = 0; descriptor_matches && i < GAMEPAD_REPORT_DESCRIPTOR_LENGTH; ++i) {
+        descriptor_matches = expected.bytes[i] == GAMEPAD_REPORT_DESCRIPTOR[i];
+    }
+    check(descriptor_matches, "The descriptor declares 16-bit axes");
+
+    printf("independent axes\n");
+    const uint x = get_rotary_encoder(0)->get_axis_slot();
+    const uint y = get_rotary_encoder(1)->get_axis_slot();
+    check(x == 0 && y == 1, "Rx before Ry");
+    const uint32_t count = 1u << JOYSTICK_POSITION_FRACTION_BITS;
+    report r = {};
+    uint phases[CONTROLLER_NUM_ENCODERS] = {};
+    for (uint i = 0; i < 10; ++i) {
+        step(0, 1, phases, TEST_SLOW_GAP_US, r);
+    }
+    check(r.axes[x] == 10 * count && r.axes[y] == 0, "Knob 0 only moves Rx");
+    for (uint i = 0; i < 3; ++i) {
+        step(1, -1, phases, TEST_SLOW_GAP_US, r);
+    }
+    check(r.axes[x] == 10 * count, "Knob 1 leaves Rx alone");
+    check(r.axes[y] == (AxisValue)(-3 * (int32_t)count), "Knob 1 turns Ry left");
+
+    printf("fractional steps\n");
+    const uint16_t fast_step = JOYSTICK_DEFAULT_ACCELERATION_CURVE.steps[TEST_FAST_BUCKET];
+    check(fast_step % count != 0, "The test step is not a whole count");
+    step(0, 1, phases, TEST_FAST_GAP_US, r);  // Starts the run, its gap was slow
+    const AxisValue before = r.axes[x];
+    step(0, 1, phases, TEST_FAST_GAP_US, r);
+    check((AxisValue)(r.axes[x] - before) == fast_step, "The axis moves by the exact fixed point step");
+
+    printf("fine sensitivity\n");
+    check(set_joystick_sensitivity(1, 1), "A sensitivity of 1/256 count is accepted");
+    step(0, 1, phases, TEST_SLOW_GAP_US, r);  // Ends the fast run
+    const AxisValue before_slow = r.axes[x];
+    step(0, 1, phases, TEST_SLOW_GAP_US, r);
+    check((AxisValue)(r.axes[x] - before_slow) < count, "A slow tick at the minimum sensitivity moves less than a count");
+    check((AxisValue)(r.axes[x] - before_slow) == 1, "It moves one step of the 16-bit axis");
+
+    return finish_checks();
+}
@@ -0,0 +1,171 @@
+#include <random>
+#include <vector>
+#include "sim.hpp"
+#include "check.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+
+// Drives the pins through input_irq_handler, the raw IO_IRQ_BANK0 handler,
+// and checks that a burst of edges takes one interrupt, queues one event per
+// pin with a single shared timestamp and level sample, and acknowledges
+// everything it read, and that an edge landing mid-handler is queued with
+// levels that show it. Then plays the same seeded bursts through the SDK style
+// per-pin callback and checks both queue the same events for fewer
+// interrupts. What an interrupt costs in cycles only means anything on the
+// board, where the INSTRUMENTATION build counts it.
+
+#define TEST_ROTARY_GPIO_0 CONTROLLER_LAYOUT.encoders[0].gpio_left
+#define TEST_ROTARY_GPIO_1 CONTROLLER_LAYOUT.encoders[0].gpio_right
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+#define TEST_SEED 0x5eed
+#define TEST_BURSTS 20000
+#define TEST_BURST_GAP_US 100
+
+static uint INTERRUPTS = 0;
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    ++INTERRUPTS;
+    record_event(gpio, event_mask);
+}
+
+static void counting_irq_handler() {
+    ++INTERRUPTS;
+    input_irq_handler();
+}
+
+static void start(bool bank_handler) {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    if (bank_handler) {
+        irq_set_exclusive_handler(IO_IRQ_BANK0, counting_irq_handler);
+    }
+    else {
+        gpio_set_irq_callback(&gpio_callback);
+    }
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    while (pop_events(events, EVENT_DRAIN_BATCH_LENGTH) > 0) {
+    }
+    INTERRUPTS = 0;
+}
+
+static bool any_pending() {
+    for (uint reg = 0; reg < GPIO_IRQ_STATUS_REGISTERS; ++reg) {
+        if (io_bank0_hw->proc0_irq_ctrl.ints[reg] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Run {
+    std::vector<Event> events;
+    uint interrupts;
+};
+
+// Every burst moves a random subset of the layout pins at once
+static Run play_bursts(bool bank_handler) {
+    start(bank_handler);
+    const uint32_t pins = CONTROLLER_IRQ_MASK;
+    std::mt19937 rng(TEST_SEED);
+    Run run;
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    for (uint burst = 0; burst < TEST_BURSTS; ++burst) {
+        sim_advance_time_us(TEST_BURST_GAP_US);
+        const uint32_t levels = rng() & pins;
+        sim_set_pins(pins, levels);
+        uint num_events;
+        while ((num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+            run.events.insert(run.events.end(), events, events + num_events);
+        }
+    }
+    run.interrupts = INTERRUPTS;
+    return run;
+}
+
+static bool same_events(const std::vector<Event> &a, const std::vector<Event> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].time != b[i].time || a[i].levels != b[i].levels || a[i].gpio_and_edges != b[i].gpio_and_edges) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    printf("burst\n");
+    start(true);
+    sim_set_time_us(1000);
+    const uint32_t all_pins = (1u << TEST_ROTARY_GPIO_0) | (1u << TEST_ROTARY_GPIO_1) | (1u << TEST_BUTTON_GPIO);
+    sim_set_pins(all_pins, all_pins);
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    check(INTERRUPTS == 1, "Three pins moving together take one interrupt");
+    check(num_events == 3, "One event per pin");
+    check(num_events == 3 && events[0].gpio() == TEST_ROTARY_GPIO_0 && events[1].gpio() == TEST_ROTARY_GPIO_1 && events[2].gpio() == TEST_BUTTON_GPIO, "Events queue in pin order, across status registers");
+    bool shared_sample = true;
+    for (uint i = 0; i < num_events; ++i) {
+        shared_sample = shared_sample && events[i].time == 1000 && events[i].levels == all_pins && events[i].mask() == GPIO_IRQ_EDGE_RISE;
+    }
+    check(shared_sample, "The burst shares one timestamp and one level sample");
+    check(!any_pending(), "Every edge read is acknowledged");
+
+    printf("single edge\n");
+    sim_advance_time_us(10);
+    sim_set_pin(TEST_BUTTON_GPIO, false);
+    num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    check(INTERRUPTS == 2, "One edge takes one interrupt");
+    check(num_events == 1 && events[0].gpio() == TEST_BUTTON_GPIO && events[0].mask() == GPIO_IRQ_EDGE_FALL && events[0].time == 1010, "The falling edge is queued with its time");
+
+    printf("both edges\n");
+    // Held off by a higher priority interrupt while the pin went up and down
+    io_bank0_hw->proc0_irq_ctrl.ints[TEST_BUTTON_GPIO / 8] = (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE) << (4 * (TEST_BUTTON_GPIO % 8));
+    input_irq_handler();
+    io_bank0_hw->proc0_irq_ctrl.ints[TEST_BUTTON_GPIO / 8] &= ~io_bank0_hw->intr[TEST_BUTTON_GPIO / 8];
+    num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    check(num_events == 1 && events[0].mask() == (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE), "A pin with both edges pending queues one event with both");
+    check(!any_pending(), "Both edges are acknowledged");
+
+    printf("edge during the handler\n");
+    start(true);
+    sim_advance_time_us(10);
+    sim_set_pin(TEST_BUTTON_GPIO, true);
+    pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    INTERRUPTS = 0;
+    // The button lets go just after the handler that takes the knob edge
+    // reads the pins
+    sim_set_pin_after_next_sample(TEST_BUTTON_GPIO, false);
+    sim_set_pin(TEST_ROTARY_GPIO_0, true);
+    num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    bool release_queued = false;
+    uint32_t last_button_levels = 0;
+    for (uint i = 0; i < num_events; ++i) {
+        if (events[i].gpio() == TEST_BUTTON_GPIO) {
+            release_queued = (events[i].mask() & GPIO_IRQ_EDGE_FALL) != 0;
+            last_button_levels = events[i].levels;
+        }
+    }
+    check(!sim_get_pin(TEST_BUTTON_GPIO), "The button moved mid-handler");
+    check(release_queued, "The release is queued");
+    check(((last_button_levels >> TEST_BUTTON_GPIO) & 1) == 0, "The release carries levels sampled after it");
+    check(INTERRUPTS == 2, "The late edge takes an interrupt of its own");
+    check(!any_pending(), "Nothing is left pending");
+
+    printf("against the callback\n");
+    const Run callback = play_bursts(false);
+    const Run bank = play_bursts(true);
+    check(!callback.events.empty(), "The bursts move pins");
+    check(same_events(callback.events, bank.events), "Both paths queue the same events");
+    check(bank.interrupts < callback.interrupts, "The bank handler takes fewer interrupts");
+    printf("  %-10s %10s %10s\n", "path", "irqs", "events");
+    printf("  %-10s %10u %10zu\n", "callback", callback.interrupts, callback.events.size());
+    printf("  %-10s %10u %10zu\n", "bank", bank.interrupts, bank.events.size());
+
+    return finish_checks();
+}
@@ -0,0 +1,124 @@
+#include <string.h>
+#include "sim.hpp"
+#include "check.hpp"
+#include "boot_timeline.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+#include "scanner.hpp"
+
+// Checks that each boot phase keeps its first stamp and reads back through
+// the feature report, and that capture_input_state() catches pins that
+// moved while the handlers were being set up, before the interrupt or the
+// scan could see them.
+
+#define TEST_ROTARY_GPIO_0 CONTROLLER_LAYOUT.encoders[0].gpio_left
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+
+// Whether the first encoder and button agree with their pins
+static bool handlers_match_pins() {
+    const uint32_t levels = gpio_get_all();
+    RotaryEncoder &encoder = *get_rotary_encoder(0);
+    return encoder.get_decoder().get_state() == encoder.state_from_levels(levels)
+        && get_button(0)->is_pressed() == (((levels >> TEST_BUTTON_GPIO) & 1) != 0);
+}
+
+// Handlers set up, then the pins move before the interrupt is enabled
+static void start_with_late_pins() {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    sim_set_pin(TEST_ROTARY_GPIO_0, true);
+    sim_set_pin(TEST_BUTTON_GPIO, true);
+    irq_set_exclusive_handler(IO_IRQ_BANK0, input_irq_handler);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+static void test_timeline() {
+    printf("timeline\n");
+    reset_boot_timeline();
+    sim_set_time_us(1200);
+    record_boot_phase(BOOT_PHASE_MAIN);
+    sim_set_time_us(1300);
+    record_boot_phase(BOOT_PHASE_USB_STARTED);
+    record_boot_phase(BOOT_PHASE_INPUTS_READY);
+    sim_set_time_us(60000);
+    record_boot_phase(BOOT_PHASE_MOUNTED);
+    sim_set_time_us(61000);
+    record_boot_phase(BOOT_PHASE_FIRST_REPORT);
+    // A USB reset later on
+    sim_set_time_us(5000000);
+    record_boot_phase(BOOT_PHASE_MOUNTED);
+    record_boot_phase(BOOT_PHASE_FIRST_REPORT);
+    check(get_boot_phase_us(BOOT_PHASE_MAIN) == 1200 && get_boot_phase_us(BOOT_PHASE_INPUTS_READY) == 1300, "Phases are stamped with the time since reset");
+    check(get_boot_phase_us(BOOT_PHASE_MOUNTED) == 60000 && get_boot_phase_us(BOOT_PHASE_FIRST_REPORT) == 61000, "Only the first time counts");
+
+    uint8_t buffer[64];
+    uint32_t words[NUM_BOOT_PHASES];
+    const uint16_t len = get_boot_timeline_report(buffer, sizeof(buffer));
+    memcpy(words, buffer, len);
+    check(len == sizeof(BootTimeline) && words[0] == 1200 && words[1] == 1300 && words[2] == 1300 && words[3] == 60000 && words[4] == 61000, "The report holds every phase in order");
+    check(get_boot_timeline_report(buffer, 8) == 8, "Short reads are clipped");
+
+    reset_boot_timeline();
+    get_boot_timeline_report(buffer, sizeof(buffer));
+    memcpy(words, buffer, sizeof(words));
+    check(words[0] == 0 && words[4] == 0, "Phases not reached read 0");
+}
+
+static void test_capture() {
+    printf("first state\n");
+    start_with_late_pins();
+    check(!handlers_match_pins(), "Edges before the interrupt is enabled go unseen");
+
+    start_with_late_pins();
+    capture_input_state();
+    check(handlers_match_pins(), "The capture catches pins that moved during setup");
+    check(buttons_have_changes(), "A button held at boot is reported");
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    check(pop_events(events, EVENT_DRAIN_BATCH_LENGTH) == 0, "Nothing older than the capture is queued");
+
+    sim_advance_time_us(100);
+    sim_set_pin(TEST_BUTTON_GPIO, false);
+    const uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    check(num_events == 1 && events[0].gpio() == TEST_BUTTON_GPIO, "Edges after the capture queue as usual");
+}
+
+// Runs the scan for a while, handing whatever it found to the handlers
+static void run_scan() {
+    sim_advance_time_us(SCAN_PERIOD_US * SCAN_DEBOUNCE_SAMPLES * 4);
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    const uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    for (uint i = 0; i < num_events; i++) {
+        dispatch_event(events[i]);
+    }
+}
+
+static void test_scan_capture() {
+    printf("first state, scanned\n");
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    const uint32_t levels = capture_input_state();
+    // Moves after the capture, before the scan's first pass
+    sim_set_pin(TEST_ROTARY_GPIO_0, true);
+    sim_set_pin(TEST_BUTTON_GPIO, true);
+    init_input_scan(levels);
+    run_scan();
+    check(handlers_match_pins(), "The scan starts from the capture and sees pins that moved since");
+
+    sim_advance_time_us(BUTTON_DEFAULT_LOCKOUT_US);
+    sim_set_pin(TEST_BUTTON_GPIO, false);
+    run_scan();
+    check(handlers_match_pins(), "Later changes come through the scan as usual");
+}
+
+int main() {
+    test_timeline();
+    test_capture();
+    test_scan_capture();
+    return finish_checks();
+}
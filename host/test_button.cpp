@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "sim.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "report.hpp"
+
+// Drives bouncy synthetic press/release waveforms through the button path
+// (gpio callback -> event queue -> dispatch -> Button -> button_bitmap) and
+// checks that every physical press shows up exactly once, that presses reach
+// the bitmap without waiting for the bounce to settle, and that releases
+// are never held back longer than the lockout.
+
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+#define TEST_SEED 0xb0b
+#define TEST_PRESSES 2000
+#define TEST_LOOP_US 20  // Main loop period in virtual time
+#define TEST_SETTLE_US 50000
+
+struct Edge {
+    uint64_t time;
+    bool level;
+};
+
+struct Scenario {
+    const char *name;
+    uint32_t lockout_us;
+    uint min_hold_us;
+    uint max_hold_us;
+    uint min_gap_us;  // Released time between presses
+    uint max_gap_us;
+    uint max_bounce_us;  // Ringing after each transition, must stay under the lockout
+    uint max_bounces;
+};
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+// Appends a transition to level that rings for up to max_bounce_us, and
+// returns the time it starts
+static uint64_t add_transition(std::vector<Edge> &edges, uint64_t at, bool level, const Scenario &scenario, std::mt19937 &rng) {
+    std::uniform_int_distribution<uint> bounces(0, scenario.max_bounces);
+    std::uniform_int_distribution<uint> offset(1, scenario.max_bounce_us);
+    edges.push_back({ at, level });
+    uint num_bounces = bounces(rng);
+    std::vector<uint> offsets;
+    for (uint i = 0; i < num_bounces * 2; ++i) {
+        offsets.push_back(offset(rng));
+    }
+    std::sort(offsets.begin(), offsets.end());
+    bool current = level;
+    for (uint bounce_offset : offsets) {
+        current = !current;
+        edges.push_back({ at + bounce_offset, current });
+    }
+    return at;
+}
+
+static bool run_scenario(Button *button, const Scenario &scenario, std::mt19937 &rng) {
+    button->set_lockout_us(scenario.lockout_us);
+
+    std::uniform_int_distribution<uint> hold(scenario.min_hold_us, scenario.max_hold_us);
+    std::uniform_int_distribution<uint> gap(scenario.min_gap_us, scenario.max_gap_us);
+    std::vector<Edge> edges;
+    std::vector<Edge> truth;
+    uint64_t now = time_us_64() + TEST_SETTLE_US;
+    for (uint press = 0; press < TEST_PRESSES; ++press) {
+        truth.push_back({ add_transition(edges, now, true, scenario, rng), true });
+        now += hold(rng);
+        truth.push_back({ add_transition(edges, now, false, scenario, rng), false });
+        now += gap(rng);
+    }
+    uint64_t end = now + TEST_SETTLE_US;
+
+    std::vector<Edge> observed;
+    report r = report {};
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    size_t next_edge = 0;
+    for (uint64_t loop = time_us_64(); loop < end; loop += TEST_LOOP_US) {
+        while (next_edge < edges.size() && edges[next_edge].time <= loop) {
+            sim_set_time_us(edges[next_edge].time);
+            sim_set_pin(TEST_BUTTON_GPIO, edges[next_edge].level);
+            ++next_edge;
+        }
+        sim_set_time_us(loop);
+        uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+        while (num_events > 0) {
+            for (uint i = 0; i < num_events; ++i) {
+                dispatch_event(events[i]);
+            }
+            num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+        }
+        settle_buttons(time_us_32());
+        if (buttons_have_changes()) {
+            bool was_pressed = r.button_bitmap & 1;
+            apply_buttons_to_report(r);
+            if ((bool)(r.button_bitmap & 1) != was_pressed) {
+                observed.push_back({ loop, !was_pressed });
+            }
+        }
+    }
+
+    bool ok = observed.size() == truth.size();
+    uint64_t max_latency[2] = { 0, 0 };  // Release, press
+    uint64_t total_latency[2] = { 0, 0 };
+    for (size_t i = 0; ok && i < truth.size(); ++i) {
+        if (observed[i].level != truth[i].level || observed[i].time < truth[i].time) {
+            ok = false;
+            break;
+        }
+        uint64_t latency = observed[i].time - truth[i].time;
+        max_latency[truth[i].level] = std::max(max_latency[truth[i].level], latency);
+        total_latency[truth[i].level] += latency;
+    }
+    ok = ok && max_latency[1] <= TEST_LOOP_US && max_latency[0] <= scenario.lockout_us + TEST_LOOP_US;
+
+    printf("%s: lockout %u us, %zu edges for %zu transitions\n", scenario.name, scenario.lockout_us, edges.size(), truth.size());
+    printf("  reported transitions: %zu (%lld spurious)\n", observed.size(), (long long)observed.size() - (long long)truth.size());
+    if (observed.size() == truth.size()) {
+        printf("  press latency:   avg %.1f us, max %llu us\n", (double)total_latency[1] / TEST_PRESSES, (unsigned long long)max_latency[1]);
+        printf("  release latency: avg %.1f us, max %llu us\n", (double)total_latency[0] / TEST_PRESSES, (unsigned long long)max_latency[0]);
+    }
+    printf("  %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main() {
+    sim_reset();
+    init_input_handlers();
+    Button* button = get_button(0);
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    const Scenario scenarios[] = {
+        { "held presses", BUTTON_DEFAULT_LOCKOUT_US, 20000, 200000, 20000, 200000, 1500, 8 },
+        // Released inside the lockout, so the release waits for it to end
+        { "short taps", BUTTON_DEFAULT_LOCKOUT_US, 1500, 4000, 6000, 20000, 600, 4 },
+        { "short lockout", 1000, 2000, 30000, 2000, 30000, 400, 6 },
+    };
+    std::mt19937 rng(TEST_SEED);
+    bool ok = true;
+    for (const Scenario &scenario : scenarios) {
+        ok = run_scenario(button, scenario, rng) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include "sim.hpp"
+#include "check.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "report_descriptor.hpp"
+#include "report_scheduler.hpp"
+#include "rotary_encoder.hpp"
+
+// Built with DIAL_REPORT. Spins the knob much further than one report can
+// carry while the host is slow to confirm, and checks that the deltas sent
+// add up to exactly the distance turned: nothing is lost while a transfer
+// is in flight or refused, a spin past half the axis range is not aliased,
+// and a bus reset drops motion the old host never confirmed.
+
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+#define TEST_EDGE_GAP_US 50000  // Slow enough for the bottom of the acceleration curve
+#define TEST_DELTA_LIMIT 127
+
+static_assert(sizeof(WireAxisValue) == 1 && (WireAxisValue)-1 < 0, "Needs DIAL_REPORT with 8-bit axes");
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+static void drain_events() {
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events;
+    while ((num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+        for (uint n = 0; n < num_events; ++n) {
+            dispatch_event(events[n]);
+        }
+    }
+}
+
+// Turns the knob by transitions (negative = left) and stages the result
+static void turn(int transitions, uint &phase, ReportScheduler &scheduler) {
+    for (int i = 0; i < (transitions < 0 ? -transitions : transitions); ++i) {
+        phase = (phase + (transitions < 0 ? SIM_QUADRATURE_PHASES - 1 : 1)) % SIM_QUADRATURE_PHASES;
+        sim_advance_time_us(TEST_EDGE_GAP_US);
+        sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+        drain_events();
+    }
+    drain_events();  // Anything else that moved, like the button
+    emit_rotary_encoder_rotations();
+    if (get_joystick()->has_changes()) {
+        get_joystick()->apply_to_report(scheduler.get_staged());
+    }
+    if (buttons_have_changes()) {
+        apply_buttons_to_report(scheduler.get_staged());
+    }
+}
+
+// Sends and confirms reports until there is nothing left, adding up the deltas
+static int32_t drain(ReportScheduler &scheduler, uint &reports) {
+    int32_t total = 0;
+    const wire_report* sent;
+    while ((sent = scheduler.begin_send()) != nullptr) {
+        check(sent->axes[0] >= -TEST_DELTA_LIMIT && sent->axes[0] <= TEST_DELTA_LIMIT, "Deltas stay in the logical range");
+        total += sent->axes[0];
+        scheduler.complete_send();
+        ++reports;
+    }
+    return total;
+}
+
+int main() {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    // One count per transition, every transition counts at once
+    set_rotary_encoder_consensus(1, 1);
+    set_joystick_sensitivity(1, 1);
+
+    ReportScheduler scheduler;
+    uint reports = 0;
+    uint phase = 0;
+
+    printf("descriptor\n");
+    static const uint8_t axes_expected[] = {
+        0x05, 0x01, 0x15, 0x81, 0x25, 0x7F, 0x09, 0x33, 0x95, 0x01, 0x75, 0x08, 0x81, 0x06, 0xC0,
+    };
+    const size_t axes_start = GAMEPAD_REPORT_DESCRIPTOR_LENGTH - sizeof(axes_expected);
+    bool descriptor_matches = true;
+    for (size_t i = 0; i < sizeof(axes_expected); ++i) {
+        descriptor_matches = descriptor_matches && GAMEPAD_REPORT_DESCRIPTOR[axes_start + i] == axes_expected[i];
+    }
+    check(descriptor_matches, "Rx is a relative axis from -127 to 127");
+
+    printf("first report\n");
+    check(drain(scheduler, reports) == 0 && reports == 1, "Mount sends the buttons once, with no motion");
+
+    printf("slow host\n");
+    turn(300, phase, scheduler);
+    const wire_report* first = scheduler.begin_send();
+    check(first != nullptr && first->axes[0] == TEST_DELTA_LIMIT, "A long spin fills the first report");
+    turn(100, phase, scheduler);
+    check(scheduler.begin_send() == nullptr, "Nothing more goes out until the host confirms");
+    scheduler.complete_send();
+    reports = 0;
+    check(TEST_DELTA_LIMIT + drain(scheduler, reports) == 400, "Every transition arrives, past half the axis range");
+    check(reports == 3, "The rest takes as few reports as fit it");
+
+    printf("refused send\n");
+    turn(-50, phase, scheduler);
+    check(scheduler.begin_send() != nullptr, "Turning left is sent");
+    scheduler.cancel_send();
+    reports = 0;
+    check(drain(scheduler, reports) == -50 && reports == 1, "A refused report is sent again whole");
+    check(scheduler.peek().axes[0] == 0, "GET_REPORT reads no motion");
+
+    printf("buttons\n");
+    sim_advance_time_us(TEST_EDGE_GAP_US);
+    sim_set_pin(TEST_BUTTON_GPIO, true);
+    turn(0, phase, scheduler);
+    const wire_report* pressed = scheduler.begin_send();
+    check(pressed != nullptr && pressed->button_bitmap == 1 && pressed->axes[0] == 0, "A press goes out with no motion");
+    scheduler.complete_send();
+
+    printf("bus reset\n");
+    turn(20, phase, scheduler);
+    scheduler.reset();
+    reports = 0;
+    check(drain(scheduler, reports) == 0 && reports == 1, "Motion the old host never confirmed is dropped");
+    turn(5, phase, scheduler);
+    check(drain(scheduler, reports) == 5, "New motion still arrives");
+
+    return finish_checks();
+}
@@ -0,0 +1,168 @@
+#include <vector>
+#include "sim.hpp"
+#include "check.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "flight_dump.hpp"
+#include "flight_recorder.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+
+// Records a hand-made glitchy spin, reads it back page by page the way the
+// host would over USB, and checks the records, that the recorder holds
+// still while a dump is read, that clearing and wrapping behave, and that
+// replaying the dump through the decoder reproduces every decision.
+
+#define TEST_ROTARY_GPIO_0 CONTROLLER_LAYOUT.encoders[0].gpio_left
+#define TEST_ROTARY_GPIO_1 CONTROLLER_LAYOUT.encoders[0].gpio_right
+#define TEST_EDGE_GAP_US 1000
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+static void drain() {
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events;
+    while ((num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(events[i]);
+        }
+    }
+}
+
+// One quadrature step, direction +1 = right
+static void step(uint &phase, int direction) {
+    phase = (phase + SIM_QUADRATURE_PHASES + direction) % SIM_QUADRATURE_PHASES;
+    sim_advance_time_us(TEST_EDGE_GAP_US);
+    sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+    drain();
+}
+
+// An edge that bounced back before the ISR sampled the pins
+static void bounce() {
+    sim_advance_time_us(TEST_EDGE_GAP_US);
+    record_event(TEST_ROTARY_GPIO_0, GPIO_IRQ_EDGE_RISE);
+    drain();
+}
+
+static std::vector<uint8_t> read_dump() {
+    std::vector<uint8_t> bytes;
+    FlightRecorderPage page;
+    do {
+        uint8_t buffer[64];
+        check(get_flight_recorder_report(buffer, sizeof(buffer)) == sizeof(page), "Pages are read whole");
+        memcpy(&page, buffer, sizeof(page));
+        bytes.insert(bytes.end(), buffer, buffer + sizeof(page));
+    } while (page.num_records != 0);
+    return bytes;
+}
+
+static FlightDump parse(const std::vector<uint8_t> &bytes) {
+    FlightDump dump;
+    check(parse_flight_dump(bytes.data(), bytes.size(), dump), "Dump parses");
+    return dump;
+}
+
+static void command(FlightRecorderCommand command) {
+    const uint8_t buffer[1] = { (uint8_t)command };
+    command_flight_recorder(buffer, sizeof(buffer));
+}
+
+static uint count_differences(const FlightDump &dump, uint debounce_count, uint consensus_count) {
+    const std::vector<FlightReplay> replays = replay_flight_dump(dump, debounce_count, consensus_count);
+    uint differences = 0;
+    for (size_t i = 0; i < replays.size(); ++i) {
+        if (replays[i].decision != dump.records[i].decision && !replays[i].warming_up) {
+            ++differences;
+        }
+    }
+    return differences;
+}
+
+int main() {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    printf("recording\n");
+    uint phase = 0;
+    step(phase, 1);
+    step(phase, 1);
+    bounce();
+    step(phase, 1);
+    step(phase, -1);
+    step(phase, -1);
+    // Both pins flip before the ISR gets to sample them
+    irq_set_enabled(IO_IRQ_BANK0, false);
+    sim_set_pin(TEST_ROTARY_GPIO_0, !sim_get_pin(TEST_ROTARY_GPIO_0));
+    sim_set_pin(TEST_ROTARY_GPIO_1, !sim_get_pin(TEST_ROTARY_GPIO_1));
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    record_event(TEST_ROTARY_GPIO_1, GPIO_IRQ_EDGE_RISE);
+    drain();
+    const uint32_t last_edge_time = time_us_32();
+
+    const FlightDump dump = parse(read_dump());
+    check(dump.records.size() == 7 && dump.total_records == 7, "Every edge is recorded");
+    check(!dump.wrapped(), "Nothing was overwritten");
+    check(dump.debounce_count == ROTARY_ENCODER_DEBOUNCE_COUNT && dump.consensus_count == ROTARY_ENCODER_CONSENSUS_COUNT, "Dump carries the tuning");
+    if (dump.records.size() == 7) {
+        static const RotaryEncoderDecision EXPECTED[7] = {
+            DECODE_NO_CONSENSUS,  // The window starts out empty
+            DECODE_ROTATE_RIGHT,
+            DECODE_UNCHANGED,
+            DECODE_ROTATE_RIGHT,
+            DECODE_NO_CONSENSUS,
+            DECODE_ROTATE_LEFT,
+            DECODE_INVALID,
+        };
+        for (uint i = 0; i < 7; ++i) {
+            check(dump.records[i].decision == EXPECTED[i], "Decisions are recorded");
+            check(dump.records[i].encoder == 0, "Encoder index is recorded");
+        }
+        check(flight_record_state_before(dump.records[0]) == BOTH_DOWN, "State before is recorded");
+        check(flight_record_state_after(dump.records[0]) == RIGHT_UP, "State after is recorded");
+        check(flight_record_state_before(dump.records[2]) == flight_record_state_after(dump.records[2]), "A bounce leaves the state alone");
+        check(dump.records[2].gpio_and_edges == (TEST_ROTARY_GPIO_0 | (GPIO_IRQ_EDGE_RISE << EVENT_EDGE_SHIFT)), "Raw pin and edge are recorded");
+        check(dump.records[6].time == last_edge_time, "ISR timestamp is recorded");
+    }
+
+    printf("replay\n");
+    check(count_differences(dump, dump.debounce_count, dump.consensus_count) == 0, "Replay reproduces every decision");
+    check(count_differences(dump, 1, 1) == 2, "Replay without consensus counts the first step and the reversal");
+
+    printf("freeze\n");
+    uint8_t buffer[64];
+    get_flight_recorder_report(buffer, sizeof(buffer));
+    step(phase, 1);
+    read_dump();
+    check(parse(read_dump()).total_records == 7, "Edges during a dump are not recorded");
+    step(phase, 1);
+    check(parse(read_dump()).total_records == 8, "Recording resumes once the dump ends");
+    get_flight_recorder_report(buffer, sizeof(buffer));
+    command(FLIGHT_RECORDER_REWIND);
+    step(phase, 1);
+    check(parse(read_dump()).total_records == 9, "Rewinding resumes recording");
+
+    printf("clear\n");
+    command(FLIGHT_RECORDER_CLEAR);
+    const FlightDump cleared = parse(read_dump());
+    check(cleared.records.empty() && cleared.total_records == 0, "Clearing forgets every record");
+
+    printf("wrap\n");
+    for (uint i = 0; i < FLIGHT_RECORDER_LENGTH + 10; ++i) {
+        bounce();
+    }
+    step(phase, 1);
+    const FlightDump wrapped = parse(read_dump());
+    check(wrapped.total_records == FLIGHT_RECORDER_LENGTH + 11, "Overwritten records still count");
+    check(wrapped.records.size() == FLIGHT_RECORDER_LENGTH - 1, "A full ring dumps all but the slot being written");
+    check(wrapped.wrapped(), "Dump knows it wrapped");
+    check(!wrapped.records.empty() && wrapped.records.back().decision != DECODE_UNCHANGED, "Newest record comes last");
+    check(count_differences(wrapped, wrapped.debounce_count, wrapped.consensus_count) == 0, "Wrapped replay reproduces every decision");
+
+    return finish_checks();
+}
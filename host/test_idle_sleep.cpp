@@ -0,0 +1,156 @@
+#include "sim.hpp"
+#include "check.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "idle_sleep.hpp"
+#include "joystick.hpp"
+#include "report_scheduler.hpp"
+#include "rotary_encoder.hpp"
+#include "tuning.hpp"
+
+// Runs the IDLE_SLEEP checks against the real pipeline, with tinyusb played
+// by two flags. The loop sleeps once everything is handled and sent, and
+// each reason to stay awake keeps it from WFE on its own: a queued event, a
+// dropped pin, a button lockout, a pending tuning change, a tinyusb event,
+// and a free endpoint with something new to send.
+
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+#define TEST_EDGE_GAP_US 1000
+
+static ReportScheduler SCHEDULER;
+static Joystick* STICK = nullptr;
+static bool USB_EVENT_READY = false;
+static bool ENDPOINT_READY = true;
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+static bool loop_has_work() {
+    return main_loop_has_work(STICK, SCHEDULER, USB_EVENT_READY, ENDPOINT_READY);
+}
+
+static bool input_core_busy() {
+    return input_core_has_work(STICK);
+}
+
+// Tries to sleep as the loop would and returns whether it reached WFE
+static bool sleeps(bool (*has_work)()) {
+    const uint64_t before = sim_wfe_count();
+    const bool slept = sleep_unless(has_work);
+    check(sim_wfe_count() == before + (slept ? 1 : 0), "sleep_unless says whether it ran WFE");
+    return slept;
+}
+
+// As the main loop's drain_events()
+static void drain() {
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    while (num_events > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(events[i]);
+        }
+        num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    }
+    resync_dropped_inputs();
+}
+
+// Stages whatever changed and has the host take it
+static void send_report() {
+    emit_rotary_encoder_rotations();
+    if (STICK->has_changes()) {
+        STICK->apply_to_report(SCHEDULER.get_staged());
+    }
+    if (buttons_have_changes()) {
+        apply_buttons_to_report(SCHEDULER.get_staged());
+    }
+    if (SCHEDULER.begin_send() != nullptr) {
+        SCHEDULER.complete_send();
+    }
+}
+
+int main() {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    STICK = get_joystick();
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    printf("idle\n");
+    check(!sleeps(loop_has_work), "The first report has not gone out");
+    send_report();
+    check(sleeps(loop_has_work), "Loop sleeps with everything sent");
+    check(sleeps(input_core_busy), "Input core sleeps with everything published");
+    USB_EVENT_READY = true;
+    check(!sleeps(loop_has_work), "A tinyusb event keeps the loop awake");
+    USB_EVENT_READY = false;
+
+    printf("button lockout\n");
+    sim_set_pin(TEST_BUTTON_GPIO, true);
+    check(!sleeps(loop_has_work), "A queued edge keeps the loop awake");
+    check(!sleeps(input_core_busy), "A queued edge keeps the input core awake");
+    drain();
+    send_report();
+    check(!buttons_have_changes() && !has_pending_events(), "The press is handled and sent");
+    check(!sleeps(loop_has_work), "A button in its lockout keeps the loop awake");
+    check(!sleeps(input_core_busy), "A button in its lockout keeps the input core awake");
+    sim_advance_time_us(BUTTON_DEFAULT_LOCKOUT_US);
+    settle_buttons(time_us_32());
+    check(sleeps(loop_has_work), "Loop sleeps once the lockout ends");
+    sim_set_pin(TEST_BUTTON_GPIO, false);
+    drain();
+    sim_advance_time_us(BUTTON_DEFAULT_LOCKOUT_US);
+    settle_buttons(time_us_32());
+    send_report();
+    check(sleeps(loop_has_work), "Loop sleeps once the release is sent");
+
+    printf("encoder ticks\n");
+    for (uint phase = 1; phase <= SIM_QUADRATURE_PHASES; ++phase) {
+        sim_advance_time_us(TEST_EDGE_GAP_US);
+        sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase % SIM_QUADRATURE_PHASES);
+    }
+    drain();
+    check(rotary_encoders_have_pending_ticks(), "One detent is waiting to be emitted");
+    check(!sleeps(input_core_busy), "Pending ticks keep the input core awake");
+    ENDPOINT_READY = false;
+    check(sleeps(loop_has_work), "A busy endpoint waits for the USB interrupt");
+    ENDPOINT_READY = true;
+    check(!sleeps(loop_has_work), "Pending ticks keep the loop awake with a free endpoint");
+    emit_rotary_encoder_rotations();
+    STICK->apply_to_report(SCHEDULER.get_staged());
+    check(!sleeps(loop_has_work), "A staged report the host has not seen keeps the loop awake");
+    SCHEDULER.begin_send();
+    check(sleeps(loop_has_work), "A report in flight waits for the USB interrupt");
+    SCHEDULER.complete_send();
+    check(sleeps(loop_has_work), "Loop sleeps once the host has the detent");
+
+    printf("dropped pins\n");
+    set_event_pair_window_us(0);
+    for (uint i = 0; i <= EVENT_BUFFER_LENGTH; ++i) {
+        record_event(TEST_BUTTON_GPIO, i % 2 == 0 ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL);
+    }
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    while (pop_events(events, EVENT_DRAIN_BATCH_LENGTH) > 0) { }
+    check(!has_pending_events() && has_dropped_pins(), "The queue is empty with a pin dropped");
+    check(!sleeps(loop_has_work), "A dropped pin keeps the loop awake until it is resynced");
+    check(!sleeps(input_core_busy), "A dropped pin keeps the input core awake");
+    resync_dropped_inputs();
+    set_event_pair_window_us(EVENT_DEFAULT_PAIR_WINDOW_US);
+    send_report();
+    check(sleeps(loop_has_work), "Loop sleeps once the pin is resynced");
+
+    printf("tuning\n");
+    uint8_t buffer[sizeof(TuningReport)];
+    check(get_tuning_report(buffer, sizeof(buffer)) == sizeof(buffer), "Tuning report is read whole");
+    check(request_tuning(buffer, sizeof(buffer)), "Current tuning is accepted");
+    check(!sleeps(loop_has_work), "A pending tuning change keeps the loop awake");
+    check(!sleeps(input_core_busy), "A pending tuning change keeps the input core awake");
+    apply_pending_tuning();
+    send_report();
+    check(sleeps(loop_has_work), "Loop sleeps once the tuning is applied");
+
+    return finish_checks();
+}
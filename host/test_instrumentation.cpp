@@ -0,0 +1,200 @@
+#include <string.h>
+#include "sim.hpp"
+#include "check.hpp"
+#include "event.hpp"
+#include "instrumentation.hpp"
+#include "report_mailbox.hpp"
+
+// Walks hand-timed events through the instrumentation hooks in the order
+// main() calls them, and checks which histogram buckets and counters they
+// land in, what the feature reports hold, and that the dual core mailbox
+// never loses the oldest input of a superseded snapshot.
+
+static Event event_at(uint32_t time) {
+    sim_set_time_us(time);
+    return Event(0, GPIO_IRQ_EDGE_RISE);
+}
+
+static uint32_t bucket_count(LatencyStage stage, uint32_t latency_us) {
+    return get_latency_histogram(stage)[latency_bucket(latency_us)];
+}
+
+static void test_buckets() {
+    printf("buckets\n");
+    check(latency_bucket(0) == 0, "0 us goes in bucket 0");
+    check(latency_bucket(1) == 1, "1 us goes in bucket 1");
+    check(latency_bucket(2) == 2 && latency_bucket(3) == 2, "2-3 us go in bucket 2");
+    check(latency_bucket(1023) == 10 && latency_bucket(1024) == 11, "1024 us starts bucket 11");
+    check(latency_bucket(8191) == LATENCY_HISTOGRAM_BUCKETS - 2, "8191 us goes in the second to last bucket");
+    check(latency_bucket(8192) == LATENCY_HISTOGRAM_BUCKETS - 1, "8192 us starts the last bucket");
+    check(latency_bucket(0xFFFFFFFFu) == LATENCY_HISTOGRAM_BUCKETS - 1, "Huge latencies saturate");
+}
+
+static void test_single_core_flow() {
+    printf("single core flow\n");
+    reset_instrumentation();
+    Event events[2] = { event_at(100), event_at(150) };
+    sim_set_time_us(300);
+    instrument_events_decoded(events, 2);
+    stage_latency_stamp(take_decoded_latency_stamp());
+    instrument_endpoint_busy();
+    instrument_endpoint_busy();
+    instrument_report_sent(1000);
+    instrument_report_complete(2000);
+
+    check(bucket_count(LATENCY_STAGE_QUEUE, 200) == 2, "Both events queued for 128-255 us");
+    check(bucket_count(LATENCY_STAGE_STAGING, 700) == 1, "Decoded at 300, sent at 1000");
+    check(bucket_count(LATENCY_STAGE_BUS, 1000) == 1, "Sent at 1000, completed at 2000");
+    check(bucket_count(LATENCY_STAGE_END_TO_END, 1900) == 1, "Oldest edge at 100, completed at 2000");
+    check(get_instrumentation_counters().reports_skipped == 1, "A busy endpoint counts once per transfer");
+    check(get_instrumentation_counters().reports_completed == 1, "One report completed");
+
+    // Input that never changes the report is not charged to a later one
+    Event bounce = event_at(3000);
+    instrument_events_decoded(&bounce, 1);
+    stage_latency_stamp(take_decoded_latency_stamp());
+    instrument_report_unchanged();
+    instrument_report_sent(4000);
+    instrument_report_complete(5000);
+    uint32_t end_to_end = 0;
+    for (uint bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; ++bucket) {
+        end_to_end += get_latency_histogram(LATENCY_STAGE_END_TO_END)[bucket];
+    }
+    check(end_to_end == 1, "Unchanged input is dropped");
+
+    instrument_report_refused();
+    check(get_instrumentation_counters().reports_skipped == 2, "A refused send counts as skipped");
+}
+
+static void test_feature_reports() {
+    printf("feature reports\n");
+    reset_instrumentation();
+    instrument_queue_depth(7);
+    instrument_queue_depth(3);
+    instrument_event_dropped();
+    uint8_t buffer[64];
+    uint32_t words[LATENCY_HISTOGRAM_BUCKETS];
+
+    uint16_t len = get_instrumentation_report(INSTRUMENTATION_COUNTERS_REPORT_ID, buffer, sizeof(buffer));
+    memcpy(words, buffer, len);
+    check(len == 16, "Counters report is 4 words");
+    check(words[0] == 7 && words[1] == 1, "Queue high water and dropped events");
+
+    Event event = event_at(0);
+    sim_set_time_us(40);
+    instrument_events_decoded(&event, 1);
+    len = get_instrumentation_report(INSTRUMENTATION_HISTOGRAM_REPORT_ID + LATENCY_STAGE_QUEUE, buffer, sizeof(buffer));
+    memcpy(words, buffer, len);
+    check(len == LATENCY_HISTOGRAM_BUCKETS * 4, "Histogram report is every bucket");
+    check(words[latency_bucket(40)] == 1, "Histogram report holds the bucket counts");
+
+    check(get_instrumentation_report(INSTRUMENTATION_COUNTERS_REPORT_ID, buffer, 5) == 5, "Short requests are truncated");
+    check(get_instrumentation_report(INSTRUMENTATION_HISTOGRAM_REPORT_ID + NUM_LATENCY_STAGES, buffer, sizeof(buffer)) == 0, "Unknown IDs STALL");
+}
+
+static void test_isr_cycles() {
+    printf("isr cycles\n");
+    reset_instrumentation();
+    init_isr_cycle_counter();
+    check(systick_hw->rvr == ISR_CYCLE_COUNTER_WRAP && (systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS), "SysTick free-runs over 24 bits");
+
+    // The bank handler: one exit per interrupt
+    systick_hw->cvr = 1000;
+    instrument_isr_enter();
+    systick_hw->cvr = 700;
+    instrument_isr_exit(3);
+    // A per-pin callback, exiting once per call, across a SysTick wrap
+    systick_hw->cvr = 50;
+    instrument_isr_enter();
+    systick_hw->cvr = 10;
+    instrument_isr_exit(1);
+    systick_hw->cvr = ISR_CYCLE_COUNTER_WRAP - 89;
+    instrument_isr_exit(1);
+
+    const IsrCycleCounters &cycles = get_isr_cycle_counters();
+    check(cycles.interrupts == 2 && cycles.edges == 5, "Interrupts and edges");
+    check(cycles.total_cycles == 300 + 40 + 100, "Every segment is charged once, wrap included");
+    check(cycles.max_cycles == 300, "The max is per interrupt, not per callback");
+
+    uint8_t buffer[64];
+    uint32_t words[4];
+    const uint16_t len = get_instrumentation_report(INSTRUMENTATION_ISR_REPORT_ID, buffer, sizeof(buffer));
+    memcpy(words, buffer, len);
+    check(len == 16 && words[0] == 2 && words[1] == 5 && words[2] == 440 && words[3] == 300, "ISR report is the four counters");
+}
+
+static void test_wake_counters() {
+    printf("wake counters\n");
+    reset_instrumentation();
+    init_isr_cycle_counter();
+
+    // Two interrupts queue events before the loop wakes, the first one counts
+    systick_hw->cvr = 5000;
+    instrument_isr_enter();
+    systick_hw->cvr = 4900;
+    instrument_isr_exit(1);
+    instrument_idle_sleep();
+    systick_hw->cvr = 4000;
+    instrument_isr_enter();
+    systick_hw->cvr = 3900;
+    instrument_isr_exit(2);
+    systick_hw->cvr = 3700;
+    instrument_events_picked_up();
+    // An interrupt that queued nothing is not waited on
+    instrument_isr_enter();
+    systick_hw->cvr = 3600;
+    instrument_isr_exit(0);
+    systick_hw->cvr = 3000;
+    instrument_events_picked_up();
+    // Across a SysTick wrap
+    systick_hw->cvr = 20;
+    instrument_isr_enter();
+    instrument_isr_exit(1);
+    systick_hw->cvr = ISR_CYCLE_COUNTER_WRAP - 179;
+    instrument_events_picked_up();
+
+    const WakeCounters &wakes = get_wake_counters();
+    check(wakes.sleeps == 1, "Sleeps are counted");
+    check(wakes.pickups == 2, "One pickup per wait for events");
+    check(wakes.total_pickup_cycles == 1200 + 200 && wakes.max_pickup_cycles == 1200, "Pickups are timed from the first interrupt, wrap included");
+
+    uint8_t buffer[64];
+    uint32_t words[4];
+    const uint16_t len = get_instrumentation_report(INSTRUMENTATION_WAKE_REPORT_ID, buffer, sizeof(buffer));
+    memcpy(words, buffer, len);
+    check(len == 16 && words[0] == 1 && words[1] == 2 && words[2] == 1400 && words[3] == 1200, "Wake report is the four counters");
+}
+
+static void test_mailbox_stamps() {
+    printf("mailbox stamps\n");
+    ReportMailbox mailbox;
+    report r = report {};
+    LatencyStamp stamp;
+    uint32_t sequence = 0;
+
+    check(!mailbox.read_if_newer(r, stamp, sequence), "Nothing published yet");
+    check(!mailbox.has_newer(sequence), "Nothing newer yet");
+    mailbox.publish(r, LatencyStamp { 100, 110, true });
+    check(mailbox.has_newer(sequence), "A publish is newer");
+    r.button_bitmap = 1;
+    mailbox.publish(r, LatencyStamp { 200, 210, true });
+    check(mailbox.read_if_newer(r, stamp, sequence), "Newest snapshot is readable");
+    check(r.button_bitmap == 1, "Newest report wins");
+    check(stamp.valid && stamp.isr_time == 100, "Superseded snapshot passes its older stamp on");
+    check(!mailbox.read_if_newer(r, stamp, sequence), "Nothing new since");
+    check(!mailbox.has_newer(sequence), "Reading catches up");
+
+    mailbox.publish(r, LatencyStamp { 300, 310, true });
+    check(mailbox.read_if_newer(r, stamp, sequence) && stamp.isr_time == 300, "Read stamps are not reused");
+}
+
+int main() {
+    sim_reset();
+    test_buckets();
+    test_single_core_flow();
+    test_feature_reports();
+    test_isr_cycles();
+    test_wake_counters();
+    test_mailbox_stamps();
+    return finish_checks();
+}
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "sim.hpp"
+#include "check.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "report_descriptor.hpp"
+#include "rotary_encoder.hpp"
+
+// Checks what the compiler derives from a controller layout: the gamepad
+// report descriptor for a full 16 button, 4 axis layout is byte for byte
+// the hand written one the firmware used to ship, a sparse layout pads its
+// buttons and only declares its bound axes, and CONTROLLER_LAYOUT itself
+// gets its IRQ mask, dispatch table and report slots wired up.
+
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+static bool descriptor_matches(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout, uint axis_bits, const uint8_t* expected, size_t expected_length) {
+    constexpr size_t capacity = 128;
+    const DescriptorBytes<capacity> generated = make_gamepad_report_descriptor<capacity>(layout, GAMEPAD_REPORT_ID, axis_bits, false);
+    return generated.length == expected_length && memcmp(generated.bytes.data(), expected, expected_length) == 0;
+}
+
+static void test_descriptors() {
+    printf("descriptors\n");
+    constexpr ControllerLayout<4, 16> full = {
+        {{
+            EncoderLayout { 0, 1, AXIS_Z },
+            EncoderLayout { 2, 3, AXIS_ROTATION_X },
+            EncoderLayout { 4, 5, AXIS_ROTATION_Y },
+            EncoderLayout { 6, 7, AXIS_ROTATION_Z },
+        }},
+        {{
+            ButtonLayout { 8 }, ButtonLayout { 9 }, ButtonLayout { 10 }, ButtonLayout { 11 },
+            ButtonLayout { 12 }, ButtonLayout { 13 }, ButtonLayout { 14 }, ButtonLayout { 15 },
+            ButtonLayout { 16 }, ButtonLayout { 17 }, ButtonLayout { 18 }, ButtonLayout { 19 },
+            ButtonLayout { 20 }, ButtonLayout { 21 }, ButtonLayout { 22 }, ButtonLayout { 26 },
+        }},
+    };
+    static_assert(is_valid_layout(full), "Every pin is used once");
+    // GAMECON_REPORT_DESC_GAMEPAD(HID_REPORT_ID(1)) as it was
+    static const uint8_t full_expected[] = {
+        0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,
+        0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02,
+        0x05, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x09, 0x32, 0x09, 0x33, 0x09, 0x34, 0x09, 0x35,
+        0x95, 0x04, 0x75, 0x08, 0x81, 0x02,
+        0xC0,
+    };
+    check(descriptor_matches(full, 8, full_expected, sizeof(full_expected)), "Full layout matches the old descriptor");
+
+    // Both knobs on Ry: one axis, and 13 bits of padding after the buttons
+    constexpr ControllerLayout<2, 3> sparse = {
+        {{
+            EncoderLayout { 4, 5, AXIS_ROTATION_Y },
+            EncoderLayout { 6, 7, AXIS_ROTATION_Y },
+        }},
+        {{ ButtonLayout { 0 }, ButtonLayout { 1 }, ButtonLayout { 2 } }},
+    };
+    static const uint8_t sparse_expected[] = {
+        0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,
+        0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+        0x95, 0x0D, 0x75, 0x01, 0x81, 0x03,
+        0x05, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x09, 0x34,
+        0x95, 0x01, 0x75, 0x08, 0x81, 0x02,
+        0xC0,
+    };
+    check(descriptor_matches(sparse, 8, sparse_expected, sizeof(sparse_expected)), "Sparse layout pads and drops unbound axes");
+    // The same with 16-bit axes, whose logical maximum takes four bytes
+    static const uint8_t sparse_high_resolution_expected[] = {
+        0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,
+        0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+        0x95, 0x0D, 0x75, 0x01, 0x81, 0x03,
+        0x05, 0x01, 0x15, 0x00, 0x27, 0xFF, 0xFF, 0x00, 0x00, 0x09, 0x34,
+        0x95, 0x01, 0x75, 0x10, 0x81, 0x02,
+        0xC0,
+    };
+    check(descriptor_matches(sparse, 16, sparse_high_resolution_expected, sizeof(sparse_high_resolution_expected)), "16-bit axes");
+    check(axis_mask_slot(layout_axis_mask(full), AXIS_ROTATION_Y) == 2, "Slots follow the axis order");
+    check(axis_mask_slot(layout_axis_mask(sparse), AXIS_ROTATION_Y) == 0, "Unbound axes take no slot");
+
+    constexpr ControllerLayout<1, 1> shared_pin = { {{ EncoderLayout { 0, 1, AXIS_Z } }}, {{ ButtonLayout { 1 } }} };
+    static_assert(!is_valid_layout(shared_pin), "A pin claimed twice is rejected");
+    constexpr ControllerLayout<1, 0> missing_pin = { {{ EncoderLayout { 0, LAYOUT_NUM_GPIOS, AXIS_Z } }}, {} };
+    static_assert(!is_valid_layout(missing_pin), "A pin that does not exist is rejected");
+}
+
+static void test_controller_layout() {
+    printf("controller layout\n");
+    check(GAMEPAD_REPORT_DESCRIPTOR.size() == GAMEPAD_REPORT_DESCRIPTOR_LENGTH, "Descriptor is measured right");
+    check(GAMEPAD_REPORT_LENGTH == 2 + CONTROLLER_NUM_AXES * sizeof(AxisValue), "One AxisValue per bound axis after the bitmap");
+
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    gpio_set_irq_callback([](uint gpio, uint32_t event_mask) { record_event(gpio, event_mask); });
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    for (uint pin = 0; pin < LAYOUT_NUM_GPIOS; ++pin) {
+        check(is_pin_registered(pin) == (bool)((CONTROLLER_IRQ_MASK >> pin) & 1), "Exactly the layout's pins are routed");
+    }
+    for (uint index = 0; index < CONTROLLER_NUM_ENCODERS; ++index) {
+        const EncoderLayout &layout = CONTROLLER_LAYOUT.encoders[index];
+        RotaryEncoder* encoder = get_rotary_encoder(index);
+        check(encoder->get_left_pin() == layout.gpio_left && encoder->get_right_pin() == layout.gpio_right, "Encoder pins");
+        check(encoder->get_axis_slot() == axis_mask_slot(CONTROLLER_AXIS_MASK, layout.axis), "Encoder axis slot");
+    }
+    check(get_rotary_encoder(CONTROLLER_NUM_ENCODERS) == nullptr, "No encoders past the layout");
+    check(get_button(CONTROLLER_NUM_BUTTONS) == nullptr, "No buttons past the layout");
+
+    // Every button edge reaches its own bit
+    report r = {};
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    for (uint index = 0; index < CONTROLLER_NUM_BUTTONS; ++index) {
+        sim_advance_time_us(2 * BUTTON_DEFAULT_LOCKOUT_US);
+        sim_set_pin(CONTROLLER_LAYOUT.buttons[index].gpio, true);
+        uint num_events;
+        while ((num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH)) > 0) {
+            for (uint i = 0; i < num_events; ++i) {
+                dispatch_event(events[i]);
+            }
+        }
+        apply_buttons_to_report(r);
+        check(r.button_bitmap == (uint16_t)((2u << index) - 1), "Button lands on its bit");
+    }
+}
+
+int main() {
+    test_descriptors();
+    test_controller_layout();
+    return finish_checks();
+}
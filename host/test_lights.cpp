@@ -0,0 +1,69 @@
+#include <string.h>
+#include "sim.hpp"
+#include "check.hpp"
+#include "lights.hpp"
+
+// Posts light frames the way the USB side does and checks that they only
+// reach the PWM compare registers on a wrap, that the newest frame wins,
+// and that the wrap interrupt goes quiet once there is nothing left to show.
+
+#define TEST_RGB_GPIO_RED 2
+#define TEST_RGB_GPIO_GREEN 3
+#define TEST_RGB_GPIO_BLUE 4
+#define TEST_RGB_CHANNEL 16  // First channel of RGB 0
+
+int main() {
+    sim_reset();
+    uint8_t frame[LIGHT_CHANNELS] = {};
+    check(!post_light_frame(frame, sizeof(frame)), "Frames are refused before init");
+
+    init_lights();
+
+    printf("mapping\n");
+    for (uint channel = 0; channel < LIGHT_CHANNELS; ++channel) {
+        const uint gpio = LIGHT_CHANNEL_GPIOS[channel];
+        if (gpio != LIGHT_UNMAPPED) {
+            check(sim_get_pin_function(gpio) == GPIO_FUNC_PWM, "Mapped pins are switched to PWM");
+            check(sim_get_pwm_level(gpio) == 0, "Lights start off");
+        }
+    }
+    sim_pwm_wrap();
+    check(!sim_pwm_irq_pending(), "No wrap interrupt while idle");
+
+    printf("double buffering\n");
+    frame[0] = 255;
+    frame[TEST_RGB_CHANNEL] = 1;
+    frame[TEST_RGB_CHANNEL + 1] = 128;
+    frame[TEST_RGB_CHANNEL + 2] = 0;
+    check(post_light_frame(frame, sizeof(frame)), "Frame is accepted");
+    check(sim_get_pwm_level(PICO_DEFAULT_LED_PIN) == 0, "Nothing changes before the wrap");
+    sim_pwm_wrap();
+    check(sim_get_pwm_level(PICO_DEFAULT_LED_PIN) == 65535, "255 is fully on");
+    check(sim_get_pwm_level(TEST_RGB_GPIO_RED) == 257, "1 maps to 257");
+    check(sim_get_pwm_level(TEST_RGB_GPIO_GREEN) == 128 * 257, "128 maps to 128 * 257");
+    check(sim_get_pwm_level(TEST_RGB_GPIO_BLUE) == 0, "0 stays off");
+
+    printf("latest wins\n");
+    frame[0] = 10;
+    check(post_light_frame(frame, sizeof(frame)), "First frame is accepted");
+    frame[0] = 20;
+    check(post_light_frame(frame, sizeof(frame)), "Second frame is accepted");
+    frame[0] = 30;
+    sim_pwm_wrap();
+    check(sim_get_pwm_level(PICO_DEFAULT_LED_PIN) == 20 * 257, "Only the newest frame is shown");
+
+    printf("idle\n");
+    sim_pwm_wrap();
+    check(sim_get_pwm_level(PICO_DEFAULT_LED_PIN) == 20 * 257, "An idle wrap keeps the last frame");
+    sim_pwm_wrap();
+    check(!sim_pwm_irq_pending(), "The interrupt disarms itself once idle");
+
+    printf("short frame\n");
+    const uint8_t short_frame[1] = { 40 };
+    check(post_light_frame(short_frame, sizeof(short_frame)), "Short frame is accepted");
+    sim_pwm_wrap();
+    check(sim_get_pwm_level(PICO_DEFAULT_LED_PIN) == 40 * 257, "Short frame sets its channels");
+    check(sim_get_pwm_level(TEST_RGB_GPIO_GREEN) == 0, "Missing channels read as off");
+
+    return finish_checks();
+}
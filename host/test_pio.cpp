@@ -0,0 +1,172 @@
+#include <random>
+#include "sim.hpp"
+#include "check.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "quadrature_pio.hpp"
+#include "rotary_encoder.hpp"
+
+// Built with PIO_ENCODERS. Runs the quadrature PIO program in the sim's
+// instruction level model of the PIO and checks that it counts exactly what
+// the software decoder's transition table says, transition by transition and
+// over seeded waveforms with bouncing contacts and skipped steps. Then checks
+// that the encoder reaches the joystick with no event per edge, and that a
+// knob resting anywhere at boot counts nothing.
+
+#define TEST_ROTARY_GPIO_0 CONTROLLER_LAYOUT.encoders[0].gpio_left
+#define TEST_ROTARY_GPIO_1 CONTROLLER_LAYOUT.encoders[0].gpio_right
+#define TEST_ENCODER_PINS ((1u << TEST_ROTARY_GPIO_0) | (1u << TEST_ROTARY_GPIO_1))
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+#define TEST_SEED 0x5eed
+#define TEST_WAVEFORM_TRANSITIONS 20000
+#define TEST_SLOW_GAP_US 50000  // The bottom of the acceleration curve
+#define TEST_REPORT_US 1000
+
+static_assert((CONTROLLER_IRQ_MASK & TEST_ENCODER_PINS) == 0, "Encoder pins must not interrupt with PIO_ENCODERS");
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+static void set_state(RotaryEncoderState state) {
+    const uint32_t levels = ((state & 1u) << TEST_ROTARY_GPIO_0) | (((state >> 1) & 1u) << TEST_ROTARY_GPIO_1);
+    sim_set_pins(TEST_ENCODER_PINS, levels);
+}
+
+static int32_t pio_count(uint sm) {
+    return read_quadrature_pio_count(sm);
+}
+
+// Boots with the knob resting in state and lets a few reports go by
+static bool boots_still(RotaryEncoderState state) {
+    sim_reset();
+    set_state(state);
+    init_joystick();
+    init_input_handlers();
+    for (uint i = 0; i < 5; ++i) {
+        sim_advance_time_us(TEST_REPORT_US);
+        emit_rotary_encoder_rotations();
+    }
+    return pio_count(0) == 0 && !get_joystick()->has_changes();
+}
+
+int main() {
+    printf("boot levels\n");
+    check(boots_still(LEFT_UP), "A knob resting at LEFT_UP at boot counts nothing");
+    check(boots_still(RIGHT_UP), "A knob resting at RIGHT_UP at boot counts nothing");
+    check(boots_still(BOTH_UP), "A knob resting at BOTH_UP at boot counts nothing");
+
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    const uint sm = 0;  // The only encoder claims the first state machine
+    check(sim_get_pin_function(TEST_ROTARY_GPIO_0) == GPIO_FUNC_PIO0 && sim_get_pin_function(TEST_ROTARY_GPIO_1) == GPIO_FUNC_PIO0, "The encoder pins belong to pio0");
+
+    printf("transition table\n");
+    bool table_matches = true;
+    for (uint previous = 0; previous < 4; ++previous) {
+        for (uint next = 0; next < 4; ++next) {
+            set_state((RotaryEncoderState)previous);
+            const int32_t before = pio_count(sm);
+            set_state((RotaryEncoderState)next);
+            const uint8_t transition = QUADRATURE_TRANSITIONS[(previous << 2) | next];
+            const int32_t expected = !(transition & QUADRATURE_TRANSITION_VALID) ? 0
+                : (transition & QUADRATURE_TRANSITION_RIGHT) ? 1 : -1;
+            if (pio_count(sm) - before != expected) {
+                printf("  %u -> %u counted %d\n", previous, next, (int)(pio_count(sm) - before));
+                table_matches = false;
+            }
+        }
+    }
+    check(table_matches, "The PIO counts every transition as QUADRATURE_TRANSITIONS does");
+
+    printf("waveforms\n");
+    std::mt19937 rng(TEST_SEED);
+    std::uniform_int_distribution<uint> run(1, 200);
+    std::uniform_int_distribution<uint> rings(0, 4);
+    std::uniform_int_distribution<uint> per_mille(0, 999);
+    set_state(BOTH_DOWN);
+    const int32_t start = pio_count(sm);
+    int64_t position = 0;
+    int64_t skipped = 0;
+    uint phase = 0;
+    int direction = 1;
+    for (uint transition = 0, remaining = 0; transition < TEST_WAVEFORM_TRANSITIONS; ++transition) {
+        if (remaining-- == 0) {
+            direction = -direction;
+            remaining = run(rng);
+        }
+        const uint previous = phase;
+        phase = (phase + SIM_QUADRATURE_PHASES + direction) % SIM_QUADRATURE_PHASES;
+        position += direction;
+        if (per_mille(rng) < 5) {
+            // Two steps between samples, which nothing can tell the direction of
+            phase = (phase + SIM_QUADRATURE_PHASES + direction) % SIM_QUADRATURE_PHASES;
+            position += direction;
+            skipped += 2 * direction;
+            sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+            continue;
+        }
+        // The contact that moved bounces back and forth before it settles
+        for (uint ring = rings(rng); ring > 0; --ring) {
+            sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+            sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], previous);
+        }
+        sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+    }
+    check(skipped != 0, "The waveform skips steps");
+    check((int64_t)(pio_count(sm) - start) == position - skipped, "Bounces cancel out and skipped steps count nothing");
+
+    printf("joystick\n");
+    // Settle the emission stage on the count so far
+    emit_rotary_encoder_rotations();
+    report r = {};
+    Joystick &stick = *get_joystick();
+    if (stick.has_changes()) {
+        stick.apply_to_report(r);
+    }
+    const AxisValue before = r.axes[0];
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    for (uint i = 0; i < 10; ++i) {
+        sim_advance_time_us(TEST_SLOW_GAP_US);
+        phase = (phase + 1) % SIM_QUADRATURE_PHASES;
+        sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+        emit_rotary_encoder_rotations();
+    }
+    check(pop_events(events, EVENT_DRAIN_BATCH_LENGTH) == 0, "Encoder edges queue no events");
+    check(stick.has_changes(), "The joystick moved");
+    stick.apply_to_report(r);
+    check((AxisValue)(r.axes[0] - before) == 10, "Slow turns move one count per transition");
+
+    // Four transitions per report, 250 us apart on average. Few enough that
+    // the 8-bit axis does not wrap at the top of the curve.
+    const AxisValue before_fast = r.axes[0];
+    for (uint report = 0; report < 2; ++report) {
+        for (uint i = 0; i < 4; ++i) {
+            sim_advance_time_us(TEST_REPORT_US / 4);
+            phase = (phase + 1) % SIM_QUADRATURE_PHASES;
+            sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+        }
+        emit_rotary_encoder_rotations();
+    }
+    stick.apply_to_report(r);
+    check((AxisValue)(r.axes[0] - before_fast) > 2 * 8, "Fast turns reach the acceleration curve");
+
+    printf("button\n");
+    sim_advance_time_us(TEST_SLOW_GAP_US);
+    sim_set_pin(TEST_BUTTON_GPIO, true);
+    const uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    check(num_events == 1 && events[0].gpio() == TEST_BUTTON_GPIO, "The button still interrupts");
+    for (uint i = 0; i < num_events; ++i) {
+        dispatch_event(events[i]);
+    }
+    check(buttons_have_changes(), "The button press is seen");
+
+    return finish_checks();
+}
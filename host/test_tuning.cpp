@@ -0,0 +1,121 @@
+#include <string.h>
+#include "sim.hpp"
+#include "check.hpp"
+#include "button.hpp"
+#include "dispatch.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+#include "tuning.hpp"
+
+// Round-trips the tuning feature report: the defaults read back, malformed
+// or out of range requests are refused, a valid one only lands once the
+// input side applies it, and the decoder and joystick then behave by the
+// new values.
+
+#define TEST_BUTTON_GPIO CONTROLLER_LAYOUT.buttons[0].gpio
+#define TEST_EDGE_GAP_US 50000  // Slow enough for the bottom of the acceleration curve
+
+static void gpio_callback(uint gpio, uint32_t event_mask) {
+    record_event(gpio, event_mask);
+}
+
+static TuningReport read_tuning() {
+    TuningReport tuning;
+    uint8_t buffer[64];
+    check(get_tuning_report(buffer, sizeof(buffer)) == sizeof(TuningReport), "Tuning report is read whole");
+    memcpy(&tuning, buffer, sizeof(tuning));
+    return tuning;
+}
+
+static bool send_tuning(const TuningReport &tuning) {
+    uint8_t buffer[sizeof(TuningReport)];
+    memcpy(buffer, &tuning, sizeof(tuning));
+    return request_tuning(buffer, sizeof(buffer));
+}
+
+// Moves the knob one step right and returns how far the axis moved
+static int step_right(Joystick* stick, report &r, uint &phase) {
+    const uint8_t before = r.axes[0];
+    phase = (phase + 1) % SIM_QUADRATURE_PHASES;
+    sim_advance_time_us(TEST_EDGE_GAP_US);
+    sim_set_encoder_phase(CONTROLLER_LAYOUT.encoders[0], phase);
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    for (uint i = 0; i < num_events; ++i) {
+        dispatch_event(events[i]);
+    }
+    emit_rotary_encoder_rotations();
+    if (stick->has_changes()) {
+        stick->apply_to_report(r);
+    }
+    return (uint8_t)(r.axes[0] - before);
+}
+
+int main() {
+    sim_reset();
+    init_joystick();
+    init_input_handlers();
+    Joystick* stick = get_joystick();
+    gpio_set_irq_callback(&gpio_callback);
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    printf("defaults\n");
+    TuningReport tuning = read_tuning();
+    check(tuning.version == TUNING_REPORT_VERSION, "Version");
+    check(tuning.encoder_debounce_count == ROTARY_ENCODER_DEBOUNCE_COUNT, "Debounce count");
+    check(tuning.encoder_consensus_count == ROTARY_ENCODER_CONSENSUS_COUNT, "Consensus count");
+    check(tuning.joystick_sensitivity == JOYSTICK_SENSITIVITY, "Sensitivity");
+    check(tuning.joystick_max_sensitivity == JOYSTICK_ACCELERATION_MAX_SENSITIVITY, "Max sensitivity");
+    check(tuning.event_pair_window * EVENT_PAIR_WINDOW_UNIT_US == EVENT_DEFAULT_PAIR_WINDOW_US, "Pair window");
+    check(tuning.button_lockout_us[0] == BUTTON_DEFAULT_LOCKOUT_US, "Button 0 lockout");
+    check(tuning.button_lockout_us[1] == 0, "Missing buttons read back as 0");
+
+    printf("refused requests\n");
+    TuningReport bad = tuning;
+    bad.version = TUNING_REPORT_VERSION + 1;
+    check(!send_tuning(bad), "Wrong version");
+    bad = tuning;
+    bad.encoder_consensus_count = bad.encoder_debounce_count + 1;
+    check(!send_tuning(bad), "Consensus larger than the window");
+    bad = tuning;
+    bad.encoder_debounce_count = ROTARY_ENCODER_MAX_DEBOUNCE_COUNT + 1;
+    check(!send_tuning(bad), "Window larger than the shift register");
+    bad = tuning;
+    bad.joystick_max_sensitivity = bad.joystick_sensitivity - 1;
+    check(!send_tuning(bad), "Acceleration slowing the axis down");
+    uint8_t short_buffer[sizeof(TuningReport) - 1] = {};
+    check(!request_tuning(short_buffer, sizeof(short_buffer)), "Short report");
+
+    printf("accepted request\n");
+    TuningReport next = tuning;
+    next.encoder_debounce_count = 1;
+    next.encoder_consensus_count = 1;
+    next.joystick_sensitivity = 4;
+    next.joystick_max_sensitivity = 4;
+    next.event_pair_window = 0;
+    next.button_lockout_us[0] = 1234;
+    next.button_lockout_us[1] = 999;
+    check(send_tuning(next), "Valid request is queued");
+    check(!send_tuning(next), "A second request waits for the first to apply");
+    check(read_tuning().joystick_sensitivity == JOYSTICK_SENSITIVITY, "Nothing changes before the input side applies it");
+    apply_pending_tuning();
+    TuningReport applied = read_tuning();
+    check(applied.encoder_debounce_count == 1 && applied.encoder_consensus_count == 1, "Consensus applied");
+    check(applied.joystick_sensitivity == 4 && applied.joystick_max_sensitivity == 4, "Sensitivity applied");
+    check(applied.event_pair_window == 0 && get_event_pair_window_us() == 0, "Pair window applied");
+    check(applied.button_lockout_us[0] == 1234, "Button lockout applied");
+    check(applied.button_lockout_us[1] == 0, "Missing buttons stay missing");
+    check(send_tuning(next), "The next request is accepted once applied");
+    apply_pending_tuning();
+
+    printf("behaviour\n");
+    report r = report {};
+    uint phase = 0;
+    // With a window of one every step counts at once, at the flat sensitivity
+    check(step_right(stick, r, phase) == 4, "First step moves the axis by the new sensitivity");
+    check(step_right(stick, r, phase) == 4, "Second step too");
+
+    return finish_checks();
+}
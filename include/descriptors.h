@@ -1,33 +1,8 @@
 #include "common/tusb_common.h"
 #include "device/usbd.h"
 
-// Gamepad Report Descriptor Template
-// with 16 buttons and 2 joysticks with following layout
-// | Button Map (2 bytes) |  X | Y | Z | Rz
-#define GAMECON_REPORT_DESC_GAMEPAD(...)                   \
-    HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),                \
-        HID_USAGE(HID_USAGE_DESKTOP_GAMEPAD),              \
-        HID_COLLECTION(HID_COLLECTION_APPLICATION),        \
-        __VA_ARGS__                                        \
-            HID_USAGE_PAGE(HID_USAGE_PAGE_BUTTON),         \
-        HID_USAGE_MIN(1),                                  \
-        HID_USAGE_MAX(16),                                 \
-        HID_LOGICAL_MIN(0),                                \
-        HID_LOGICAL_MAX(1),                                \
-        HID_REPORT_COUNT(16),                              \
-        HID_REPORT_SIZE(1),                                \
-        HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), \
-        HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),            \
-        HID_LOGICAL_MIN(0x00),                             \
-        HID_LOGICAL_MAX_N(0x00ff, 2),                      \
-        HID_USAGE(HID_USAGE_DESKTOP_Z),                    \
-        HID_USAGE(HID_USAGE_DESKTOP_RX),                   \
-        HID_USAGE(HID_USAGE_DESKTOP_RY),                   \
-        HID_USAGE(HID_USAGE_DESKTOP_RZ),                   \
-        HID_REPORT_COUNT(4),                               \
-        HID_REPORT_SIZE(8),                                \
-        HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), \
-        HID_COLLECTION_END
+// The gamepad collection is generated from CONTROLLER_LAYOUT, see
+// src/report_descriptor.hpp
 
 #define GAMECON_REPORT_DESC_LIGHTS(...)                         \
     HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),                     \
@@ -46,3 +21,88 @@
         HID_USAGE_MAX(1),                                       \
         HID_INPUT(HID_CONSTANT | HID_VARIABLE | HID_ABSOLUTE),  \
         HID_COLLECTION_END
+
+
+// Vendor defined feature report holding the runtime parameters (TuningReport)
+#define GAMECON_REPORT_DESC_TUNING(...)                          \
+    HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),                  \
+        HID_USAGE(0x10),                                         \
+        HID_COLLECTION(HID_COLLECTION_APPLICATION),              \
+        __VA_ARGS__                                              \
+            HID_USAGE(0x11),                                     \
+        HID_LOGICAL_MIN(0x00),                                   \
+        HID_LOGICAL_MAX_N(0x00ff, 2),                            \
+        HID_REPORT_SIZE(8),                                      \
+        HID_REPORT_COUNT(TUNING_REPORT_LENGTH),                  \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),     \
+        HID_COLLECTION_END
+
+// Vendor defined feature report holding the boot phase stamps (BootTimeline)
+#define GAMECON_REPORT_DESC_BOOT_TIMELINE(...)                   \
+    HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),                  \
+        HID_USAGE(0x30),                                         \
+        HID_COLLECTION(HID_COLLECTION_APPLICATION),              \
+        __VA_ARGS__                                              \
+            HID_USAGE(0x31),                                     \
+        HID_LOGICAL_MIN(0x00),                                   \
+        HID_LOGICAL_MAX_N(0x00ff, 2),                            \
+        HID_REPORT_SIZE(8),                                      \
+        HID_REPORT_COUNT(20),                                    \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),     \
+        HID_COLLECTION_END
+
+// Vendor defined feature reports for the INSTRUMENTATION build: the counters
+// (4 x uint32), one histogram per latency stage (15 x uint32 buckets), the
+// interrupt cycle counters (4 x uint32) and the wake counters (4 x uint32),
+// all little endian and declared as plain bytes
+#define GAMECON_REPORT_DESC_INSTRUMENTATION(COUNTERS_ID, HISTOGRAM_ID, ISR_ID, WAKE_ID)  \
+    HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),                         \
+        HID_USAGE(0x01),                                                \
+        HID_COLLECTION(HID_COLLECTION_APPLICATION),                     \
+        HID_LOGICAL_MIN(0x00),                                          \
+        HID_LOGICAL_MAX_N(0x00ff, 2),                                   \
+        HID_REPORT_SIZE(8),                                             \
+        HID_REPORT_ID(COUNTERS_ID)                                      \
+        HID_USAGE(0x02),                                                \
+        HID_REPORT_COUNT(16),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_REPORT_ID(HISTOGRAM_ID)                                     \
+        HID_USAGE(0x03),                                                \
+        HID_REPORT_COUNT(60),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_REPORT_ID(HISTOGRAM_ID + 1)                                 \
+        HID_USAGE(0x03),                                                \
+        HID_REPORT_COUNT(60),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_REPORT_ID(HISTOGRAM_ID + 2)                                 \
+        HID_USAGE(0x03),                                                \
+        HID_REPORT_COUNT(60),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_REPORT_ID(HISTOGRAM_ID + 3)                                 \
+        HID_USAGE(0x03),                                                \
+        HID_REPORT_COUNT(60),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_REPORT_ID(ISR_ID)                                           \
+        HID_USAGE(0x04),                                                \
+        HID_REPORT_COUNT(16),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_REPORT_ID(WAKE_ID)                                          \
+        HID_USAGE(0x05),                                                \
+        HID_REPORT_COUNT(16),                                           \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),            \
+        HID_COLLECTION_END
+
+// Vendor defined feature report for the FLIGHT_RECORDER build: one page of
+// the dump (FlightRecorderPage) per GET_REPORT, a command byte on SET_REPORT
+#define GAMECON_REPORT_DESC_FLIGHT_RECORDER(...)                 \
+    HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),                  \
+        HID_USAGE(0x20),                                         \
+        HID_COLLECTION(HID_COLLECTION_APPLICATION),              \
+        __VA_ARGS__                                              \
+            HID_USAGE(0x21),                                     \
+        HID_LOGICAL_MIN(0x00),                                   \
+        HID_LOGICAL_MAX_N(0x00ff, 2),                            \
+        HID_REPORT_SIZE(8),                                      \
+        HID_REPORT_COUNT(56),                                    \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),     \
+        HID_COLLECTION_END
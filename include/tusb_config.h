@@ -85,7 +85,8 @@ extern "C"
 #define CFG_TUD_VENDOR 0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_BUFSIZE 32
+// 64 fits the largest feature report, a latency histogram
+#define CFG_TUD_HID_BUFSIZE 64
 
 #ifdef __cplusplus
 }
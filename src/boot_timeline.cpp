@@ -0,0 +1,36 @@
+#include <atomic>
+#include <string.h>
+#include "boot_timeline.hpp"
+
+// INPUTS_READY comes from core 1 with DUAL_CORE, the rest from core 0
+static std::atomic<uint32_t> BOOT_PHASE_US[NUM_BOOT_PHASES];
+
+// Only the first time counts, so a later USB reset keeps the boot figures
+void record_boot_phase(BootPhase phase) {
+    if (BOOT_PHASE_US[phase].load(std::memory_order_relaxed) == 0) {
+        BOOT_PHASE_US[phase].store(time_us_32(), std::memory_order_relaxed);
+    }
+}
+
+uint32_t get_boot_phase_us(BootPhase phase) {
+    return BOOT_PHASE_US[phase].load(std::memory_order_relaxed);
+}
+
+void reset_boot_timeline() {
+    for (std::atomic<uint32_t> &time : BOOT_PHASE_US) {
+        time.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint16_t get_boot_timeline_report(uint8_t* buffer, uint16_t reqlen) {
+    BootTimeline timeline;
+    for (uint phase = 0; phase < NUM_BOOT_PHASES; ++phase) {
+        timeline.phase_us[phase] = get_boot_phase_us((BootPhase)phase);
+    }
+    uint16_t len = sizeof(timeline);
+    if (len > reqlen) {
+        len = reqlen;
+    }
+    memcpy(buffer, &timeline, len);
+    return len;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+#define BOOT_TIMELINE_REPORT_ID 12  // Must match desc_hid_report
+
+// Startup steps, in the order they finish on a normal boot. Each is stamped
+// with time_us_32() the first time it is reached. The timer starts at reset,
+// so every stamp is time since power-up.
+enum BootPhase {
+    BOOT_PHASE_MAIN,  // main() entered, after the SDK runtime init
+    BOOT_PHASE_USB_STARTED,  // tusb_init() returned
+    BOOT_PHASE_INPUTS_READY,  // Handlers set up, pins read and the input interrupt live
+    BOOT_PHASE_MOUNTED,  // The host configured the device
+    BOOT_PHASE_FIRST_REPORT,  // The first input report reached the host
+    NUM_BOOT_PHASES,
+};
+
+// The stamps as a feature report, little endian like the core. A phase not
+// reached yet reads 0; the bootrom alone takes longer than 1 us.
+struct BootTimeline {
+    uint32_t phase_us[NUM_BOOT_PHASES];
+};
+
+static_assert(sizeof(BootTimeline) == 20, "BootTimeline must match its report descriptor");
+
+// Either core, each phase only from one
+void record_boot_phase(BootPhase phase);
+uint32_t get_boot_phase_us(BootPhase phase);
+void reset_boot_timeline();
+
+// USB side
+uint16_t get_boot_timeline_report(uint8_t* buffer, uint16_t reqlen);
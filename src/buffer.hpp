@@ -1,5 +1,6 @@
 #pragma once
 #include "pico/stdlib.h"
+#include <atomic>
 #include <optional>
 
 template <typename T> 
@@ -56,6 +57,104 @@ public:
     }
 };
 
+// Single producer / single consumer ring. The producer (an IRQ handler) only
+// writes head and the consumer (the main loop) only writes tail, so neither
+// side needs a lock. Indices run freely and are masked on access, which is
+// why the capacity must be a power of two.
+template <typename T, uint CAPACITY>
+class SPSCRingQueue {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SPSCRingQueue capacity must be a power of two");
+private:
+    static constexpr uint MASK = CAPACITY - 1;
+    T data[CAPACITY];
+    std::atomic<uint> head;
+    std::atomic<uint> tail;
+public:
+    SPSCRingQueue():
+        head(0),
+        tail(0)
+    { }
+
+    // Producer side
+    bool push(const T &val) {
+        const uint write_index = head.load(std::memory_order_relaxed);
+        if (write_index - tail.load(std::memory_order_acquire) == CAPACITY) [[unlikely]] {
+            return false;
+        }
+        data[write_index & MASK] = val;
+        head.store(write_index + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side. Queues all len values and publishes them with a single
+    // index update, or none of them if they do not all fit.
+    bool push_batch(const T* vals, uint len) {
+        const uint write_index = head.load(std::memory_order_relaxed);
+        if (CAPACITY - (write_index - tail.load(std::memory_order_acquire)) < len) [[unlikely]] {
+            return false;
+        }
+        for (uint i = 0; i < len; ++i) {
+            data[(write_index + i) & MASK] = vals[i];
+        }
+        head.store(write_index + len, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side. The value pushed last, or nullptr unless more than
+    // min_len values are queued. A pop_batch() only ever copies the oldest
+    // max_len values, so with min_len at least that, the value returned is out
+    // of its reach and drop_newest() may take it back. That only holds while
+    // the consumer can not advance in between, as when the producer is an
+    // interrupt on the consumer's core.
+    const T* peek_newest(uint min_len) {
+        const uint write_index = head.load(std::memory_order_relaxed);
+        if (write_index - tail.load(std::memory_order_acquire) <= min_len) {
+            return nullptr;
+        }
+        return &data[(write_index - 1) & MASK];
+    }
+
+    // Producer side, only after peek_newest() returned a value
+    void drop_newest() {
+        head.store(head.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+    }
+
+    // Consumer side
+    std::optional<T> pop() {
+        const uint read_index = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == read_index) {
+            return std::nullopt;
+        }
+        T val = data[read_index & MASK];
+        tail.store(read_index + 1, std::memory_order_release);
+        return std::optional<T>{val};
+    }
+
+    // Consumer side. Copies up to max_len queued values into out and releases
+    // their slots with a single index update; returns how many were copied.
+    uint pop_batch(T* out, uint max_len) {
+        const uint read_index = tail.load(std::memory_order_relaxed);
+        uint len = head.load(std::memory_order_acquire) - read_index;
+        if (len > max_len) {
+            len = max_len;
+        }
+        for (uint i = 0; i < len; ++i) {
+            out[i] = data[(read_index + i) & MASK];
+        }
+        tail.store(read_index + len, std::memory_order_release);
+        return len;
+    }
+
+    // Consumer side
+    void reset() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    uint get_len() {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+};
+
 template <typename T> 
 class CircularOverflowBuffer {
 private:
@@ -1,62 +1,64 @@
+#include <utility>
 #include "button.hpp"
 
-Button::Button(uint pin):
-    pressed(false),
-    last_update(0),
-    gpio_pin(pin)
-{
-    if (++num_buttons > MAX_BUTTONS) [[unlikely]] {
-        panic("Number of buttons (%u) exceeds maximum (%u)!\n", num_buttons, MAX_BUTTONS);
-    }
-    gpio_init(pin);
-    gpio_set_dir(pin, GPIO_IN);
-    gpio_pull_down(pin);
-    refresh_state();
+static uint16_t BUTTON_BITMAP = 0;
+static bool BUTTON_BITMAP_CHANGED = false;
+
+template <size_t... INDICES>
+static constexpr std::array<Button, CONTROLLER_NUM_BUTTONS> make_buttons(std::index_sequence<INDICES...>) {
+    return {{ Button(CONTROLLER_LAYOUT.buttons[INDICES], INDICES)... }};
 }
 
-void Button::refresh_state() {
-    pressed = gpio_get(gpio_pin);
-    last_update = time_us_64();
+static constexpr std::array<Button, CONTROLLER_NUM_BUTTONS> LAYOUT_BUTTONS = make_buttons(std::make_index_sequence<CONTROLLER_NUM_BUTTONS>());
+static std::array<Button, CONTROLLER_NUM_BUTTONS> BUTTONS = LAYOUT_BUTTONS;
+
+void Button::init_pins() {
+    gpio_init(gpio_pin);
+    gpio_set_dir(gpio_pin, GPIO_IN);
+    gpio_pull_down(gpio_pin);
+    refresh_state(gpio_get_all());
 }
 
-bool Button::create_and_register(uint pin) {
-    if (!BUTTON_STATICS_INITIALIZED) {
-        panic("Attempted to create a Button handler before intializing statics!\n");
-    }
-    if (num_buttons < MAX_BUTTONS) {
-        if (PIN_TO_BUTTON_HANDLER_MAP[pin].has_value()) {
-            return false;
-        }
-        const uint index = num_buttons;
-        BUTTONS[index] = Button(pin);
-        PIN_TO_BUTTON_HANDLER_MAP[pin] = index;
-        return true;
+// Starts over from the pin's level in levels, a gpio_get_all() read
+void Button::refresh_state(uint32_t levels) {
+    last_level = (levels >> gpio_pin) & 1;
+    last_edge = time_us_32();
+    locked = false;
+    apply_level(last_level, last_edge);
+}
+
+void Button::apply_level(bool level, uint32_t now) {
+    if (level == pressed) {
+        return;
     }
-    return false;
+    pressed = level;
+    last_update = now;
+    locked = true;
+    BUTTON_BITMAP ^= 1u << index;  // The bit always mirrors pressed
+    BUTTON_BITMAP_CHANGED = true;
+    #ifdef DEBUG_MODE
+    printf(pressed ? "D\n" : "U\n");
+    #endif
 }
 
 void Button::handle_event(const TimedButtonEvent &event) {
-    std::optional<bool> is_now_pressed = std::nullopt;
-    switch (event.event) {
-        case BUTTON_UP:
-            if (pressed) {
-                is_now_pressed = false;
-            }
-            break;
-        case BUTTON_DOWN:
-            if (!pressed) {
-                is_now_pressed = true;
-            }
-            break;
-    }
-    if (is_now_pressed.has_value()) {
-        pressed = is_now_pressed.value();
-        if (pressed) {
-            printf("D\n");
-        }
-        else {
-            printf("U\n");
+    last_level = event.event == BUTTON_DOWN;
+    last_edge = event.time;
+    if (locked) {
+        if (event.time - last_update < lockout_us) {  // Wrap-safe
+            return;  // Bouncing
         }
+        locked = false;
+    }
+    apply_level(last_level, event.time);
+}
+
+// Ends an expired lockout and catches up with the level the pin settled on.
+// Call regularly, since no edge may arrive after the bouncing stops.
+void Button::settle(uint32_t now) {
+    if (locked && now - last_update >= lockout_us) {
+        locked = false;
+        apply_level(last_level, last_edge);
     }
 }
 
@@ -64,47 +66,89 @@ uint Button::get_pin() {
     return gpio_pin;
 }
 
+bool Button::is_pressed() {
+    return pressed;
+}
+
+bool Button::is_locked() {
+    return locked;
+}
+
+uint32_t Button::get_lockout_us() {
+    return lockout_us;
+}
+
+void Button::set_lockout_us(uint32_t lockout_us) {
+    this->lockout_us = lockout_us;
+}
+
+// Starts every button in CONTROLLER_LAYOUT over from its pin level with the
+// default lockout
 void init_button_handling() {
-    for (uint button = 0; button < MAX_BUTTONS; ++button) {
-        BUTTONS[button] = std::nullopt;
+    BUTTON_BITMAP = 0;
+    BUTTON_BITMAP_CHANGED = false;
+    BUTTONS = LAYOUT_BUTTONS;
+    for (Button &button : BUTTONS) {
+        button.init_pins();
     }
-    for (uint pin = 0; pin < MAX_GPIO_PINS; ++pin) {
-        PIN_TO_BUTTON_HANDLER_MAP[pin] = std::nullopt;
+}
+
+// nullptr if the layout has no such button
+Button* get_button(uint index) {
+    return index < CONTROLLER_NUM_BUTTONS ? &BUTTONS[index] : nullptr;
+}
+
+void handle_button_event(PinHandler handler, const Event &event) {
+    Button& button = BUTTONS[handler.index];
+    // The snapshot says where the pin is now, even if edges were coalesced
+    bool level = (event.levels >> button.get_pin()) & 1;
+    button.handle_event(TimedButtonEvent { level ? BUTTON_DOWN : BUTTON_UP, event.time });
+}
+
+// Picks the button up from its pin, after events it needed were dropped
+void resync_button(PinHandler handler, uint32_t levels) {
+    BUTTONS[handler.index].refresh_state(levels);
+}
+
+void settle_buttons(uint32_t now) {
+    for (Button &button : BUTTONS) {
+        button.settle(now);
     }
-    BUTTON_STATICS_INITIALIZED = true;
-}
-
-void handle_button_event(const Event &event) {
-    uint gpio = event.gpio;
-    uint32_t event_mask = event.mask;
-    uint64_t at = event.time;
-    std::optional<uint> button_index = PIN_TO_BUTTON_HANDLER_MAP[gpio];
-    if (button_index.has_value()) {
-        std::optional<Button>& button = BUTTONS[button_index.value()];
-        if (button.has_value()) {
-            bool edge_fall = event_mask & GPIO_IRQ_EDGE_FALL;
-            bool edge_rise = event_mask & GPIO_IRQ_EDGE_RISE;
-            if (edge_rise && edge_fall) {
-                // Do nothing...
-            }
-            else if (edge_fall) {
-                button.value().handle_event(TimedButtonEvent { BUTTON_UP, at });
-            }
-            else if (edge_rise) {
-                button.value().handle_event(TimedButtonEvent { BUTTON_DOWN, at });
-            }
-            
+}
+
+// False while any button is locked out, since only settle_buttons() ends a
+// lockout and no edge may come to prompt it
+bool buttons_are_settled() {
+    for (Button &button : BUTTONS) {
+        if (button.is_locked()) {
+            return false;
         }
     }
+    return true;
 }
 
-void enable_button_irq() {
-    for (uint button_index = 0; button_index < MAX_BUTTONS; ++button_index) {
-        std::optional<Button>& button = BUTTONS[button_index];
-        if (button.has_value()) {
-            gpio_set_irq_enabled(button.value().get_pin(), GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
-        }
+bool buttons_have_changes() {
+    return BUTTON_BITMAP_CHANGED;
+}
+
+void apply_buttons_to_report(report &report) {
+    report.button_bitmap = BUTTON_BITMAP;
+    BUTTON_BITMAP_CHANGED = false;
+}
+
+// Index as in button_bitmap. Returns false if there is no such button
+bool set_button_lockout_us(uint index, uint32_t lockout_us) {
+    if (index >= CONTROLLER_NUM_BUTTONS) {
+        return false;
     }
+    BUTTONS[index].set_lockout_us(lockout_us);
+    return true;
 }
 
-uint Button::num_buttons = 0;
+// 0 if there is no such button
+uint32_t get_button_lockout_us(uint index) {
+    if (index >= CONTROLLER_NUM_BUTTONS) {
+        return 0;
+    }
+    return BUTTONS[index].get_lockout_us();
+}
@@ -1,11 +1,18 @@
 #pragma once
-#include <optional>
+#include <array>
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "const.hpp"
+#include "controller_layout.hpp"
+#include "dispatch.hpp"
 #include "event.hpp"
+#include "report.hpp"
 
-#define MAX_BUTTONS 7
+#define MAX_BUTTONS 16  // One per bit of report::button_bitmap
+#define BUTTON_DEFAULT_LOCKOUT_US 5000u
+
+static_assert(MAX_BUTTONS <= MAX_PIN_HANDLER_INDEX + 1, "Button indices must fit in the pin dispatch table");
+static_assert(CONTROLLER_NUM_BUTTONS <= MAX_BUTTONS, "CONTROLLER_LAYOUT has more buttons than button_bitmap has bits");
 
 enum ButtonEventType {
     BUTTON_UP,
@@ -14,29 +21,57 @@ enum ButtonEventType {
 
 struct TimedButtonEvent {
     ButtonEventType event;
-    uint64_t time;
+    uint32_t time;
 };
 
+// Debounces eagerly: the first edge out of a settled state is reported at
+// once, then the pin is ignored for lockout_us while the contacts bounce.
+// Whatever level the pin settled on is picked up when the lockout ends, and
+// since the pin has been quiet since its last edge, the new lockout counts
+// from that edge rather than from the catch-up.
 class Button {
 private:
-    static uint num_buttons;
     bool pressed;
-    uint64_t last_update;
-    uint gpio_pin;
+    bool last_level;  // Most recent level seen, including during lockout
+    bool locked;
+    uint32_t last_update;
+    uint32_t last_edge;
+    uint32_t lockout_us;
+    uint8_t gpio_pin;
+    uint8_t index;
 
-    Button(uint pin);
-    void refresh_state();
+    void apply_level(bool level, uint32_t now);
 
 public:
-    static bool create_and_register(uint pin);
+    constexpr Button(const ButtonLayout &layout, uint index):
+        pressed(false),
+        last_level(false),
+        locked(false),
+        last_update(0),
+        last_edge(0),
+        lockout_us(BUTTON_DEFAULT_LOCKOUT_US),
+        gpio_pin(layout.gpio),
+        index((uint8_t)index)
+    { }
+
+    void init_pins();
+    void refresh_state(uint32_t levels);
     void handle_event(const TimedButtonEvent &event);
+    void settle(uint32_t now);
     uint get_pin();
+    bool is_pressed();
+    bool is_locked();
+    uint32_t get_lockout_us();
+    void set_lockout_us(uint32_t lockout_us);
 };
 
-static std::optional<Button> BUTTONS[MAX_BUTTONS];
-static std::optional<uint> PIN_TO_BUTTON_HANDLER_MAP[MAX_GPIO_PINS];
-static bool BUTTON_STATICS_INITIALIZED = false;
-
 void init_button_handling();
-void handle_button_event(const Event &event);
-void enable_button_irq();
+Button* get_button(uint index);
+void handle_button_event(PinHandler handler, const Event &event);
+void resync_button(PinHandler handler, uint32_t levels);
+void settle_buttons(uint32_t now);
+bool buttons_are_settled();
+bool buttons_have_changes();
+void apply_buttons_to_report(report &report);
+bool set_button_lockout_us(uint index, uint32_t lockout_us);
+uint32_t get_button_lockout_us(uint index);
@@ -0,0 +1,42 @@
+#pragma once
+#include "layout.hpp"
+
+// The cabinet this firmware is built for. Adding a knob or a button, or
+// moving one to another pin or axis, only takes an edit here: the dispatch
+// table, IRQ mask, input report and its descriptor all follow.
+#ifdef TWO_KNOB_LAYOUT
+// A second knob on its own axis. GPIO 2-4 are taken by the RGB light.
+constexpr ControllerLayout<2, 1> CONTROLLER_LAYOUT = {
+    {{
+        EncoderLayout { 0, 1, AXIS_ROTATION_X },
+        EncoderLayout { 6, 7, AXIS_ROTATION_Y },
+    }},
+    {{
+        ButtonLayout { 16 },
+    }},
+};
+#else
+constexpr ControllerLayout<1, 1> CONTROLLER_LAYOUT = {
+    {{
+        EncoderLayout { 0, 1, AXIS_ROTATION_X },
+    }},
+    {{
+        ButtonLayout { 16 },
+    }},
+};
+#endif
+
+static_assert(is_valid_layout(CONTROLLER_LAYOUT), "CONTROLLER_LAYOUT reuses a pin or does not fit the report");
+
+constexpr uint CONTROLLER_NUM_ENCODERS = CONTROLLER_LAYOUT.encoders.size();
+constexpr uint CONTROLLER_NUM_BUTTONS = CONTROLLER_LAYOUT.buttons.size();
+#ifdef PIO_ENCODERS
+// The PIO watches the encoder pins, only the buttons interrupt or get scanned
+constexpr uint32_t CONTROLLER_IRQ_MASK = layout_button_mask(CONTROLLER_LAYOUT);
+#else
+constexpr uint32_t CONTROLLER_IRQ_MASK = layout_irq_mask(CONTROLLER_LAYOUT);
+#endif
+constexpr uint32_t CONTROLLER_AXIS_MASK = layout_axis_mask(CONTROLLER_LAYOUT);
+constexpr uint CONTROLLER_NUM_AXES = axis_mask_count(CONTROLLER_AXIS_MASK);
+
+static_assert(CONTROLLER_NUM_AXES >= 1, "The input report needs at least one axis");
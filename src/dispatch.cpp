@@ -0,0 +1,147 @@
+#include "dispatch.hpp"
+#include "hardware/structs/iobank0.h"
+#include "button.hpp"
+#include "controller_layout.hpp"
+#include "instrumentation.hpp"
+#include "rotary_encoder.hpp"
+
+static constexpr std::array<PinHandler, MAX_GPIO_PINS> PIN_HANDLERS = make_pin_dispatch_table(CONTROLLER_LAYOUT);
+
+static void ignore_event(PinHandler handler, const Event &event) {
+    (void)handler;
+    (void)event;
+}
+
+// Indexed by PinHandlerKind
+static const PinHandlerFn PIN_HANDLER_FNS[NUM_PIN_HANDLER_KINDS] = {
+    ignore_event,
+    handle_rotary_encoder_event,
+    handle_button_event,
+};
+
+static void ignore_resync(PinHandler handler, uint32_t levels) {
+    (void)handler;
+    (void)levels;
+}
+
+// Indexed by PinHandlerKind
+static const PinResyncFn PIN_RESYNC_FNS[NUM_PIN_HANDLER_KINDS] = {
+    ignore_resync,
+    resync_rotary_encoder,
+    resync_button,
+};
+
+// Sets up every encoder and button in CONTROLLER_LAYOUT and captures the
+// level each pin starts at
+void init_input_handlers() {
+    init_rotary_encoder_handling();
+    init_button_handling();
+}
+
+// Both edges on every pin the layout uses
+void enable_input_irq() {
+    for (uint32_t pins = CONTROLLER_IRQ_MASK; pins != 0; pins &= pins - 1) {
+        gpio_set_irq_enabled(__builtin_ctz(pins), GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
+    }
+}
+
+// Both edge bits of every layout pin, laid out like the status register
+static constexpr uint32_t input_irq_edges(uint reg) {
+    uint32_t edges = 0;
+    for (uint pin = 0; pin < GPIO_IRQ_PINS_PER_REGISTER; ++pin) {
+        if ((CONTROLLER_IRQ_MASK >> (reg * GPIO_IRQ_PINS_PER_REGISTER + pin)) & 1) {
+            edges |= (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE) << (4 * pin);
+        }
+    }
+    return edges;
+}
+
+static constexpr uint32_t INPUT_IRQ_EDGES[GPIO_IRQ_STATUS_REGISTERS] = {
+    input_irq_edges(0), input_irq_edges(1), input_irq_edges(2), input_irq_edges(3),
+};
+static constexpr uint INPUT_IRQ_MAX_EVENTS = CONTROLLER_IRQ_MASK == 0 ? 1 : __builtin_popcount(CONTROLLER_IRQ_MASK);
+
+// Raw IO_IRQ_BANK0 handler, installed with irq_set_exclusive_handler in
+// place of the SDK's per-pin callback. Every edge pending on this core is
+// read, acknowledged and queued in one pass: one timer read and one level
+// sample for the whole burst, one write per status register, and one queue
+// update. Registers with no layout pins are never touched.
+//
+// Every edge is acknowledged before the pins are sampled, as the SDK does.
+// An edge landing after the acknowledgement stays pending and interrupts
+// again, while the sample already shows it. Sampling first would clear an
+// edge whose level the sample missed, and nothing would ever queue it.
+void __not_in_flash_func(input_irq_handler)() {
+    instrument_isr_enter();
+    io_irq_ctrl_hw_t* ctrl = get_core_num() ? &io_bank0_hw->proc1_irq_ctrl : &io_bank0_hw->proc0_irq_ctrl;
+    uint32_t statuses[GPIO_IRQ_STATUS_REGISTERS];
+    for (uint reg = 0; reg < GPIO_IRQ_STATUS_REGISTERS; ++reg) {
+        statuses[reg] = INPUT_IRQ_EDGES[reg] == 0 ? 0 : ctrl->ints[reg] & INPUT_IRQ_EDGES[reg];
+        if (statuses[reg] != 0) {
+            io_bank0_hw->intr[reg] = statuses[reg];  // Write 1 to clear
+        }
+    }
+    const uint32_t now = time_us_32();
+    const uint32_t levels = gpio_get_all();
+    Event events[INPUT_IRQ_MAX_EVENTS];
+    uint num_events = 0;
+    for (uint reg = 0; reg < GPIO_IRQ_STATUS_REGISTERS; ++reg) {
+        const uint32_t status = statuses[reg];
+        // A pin with both edges pending moved and came back. It queues one
+        // event with both bits, as the SDK callback would get.
+        for (uint32_t pending = status; pending != 0;) {
+            const uint pin = __builtin_ctz(pending) / 4;
+            pending &= ~(0xFu << (4 * pin));
+            events[num_events++] = Event(reg * GPIO_IRQ_PINS_PER_REGISTER + pin, status >> (4 * pin), now, levels);
+        }
+    }
+    if (num_events > 0) {
+        push_events(events, num_events);
+    }
+    instrument_isr_exit(num_events);
+}
+
+bool is_pin_registered(uint pin) {
+    return PIN_HANDLERS[pin].kind != NO_HANDLER;
+}
+
+void dispatch_event(const Event &event) {
+    const PinHandler handler = PIN_HANDLERS[event.gpio()];
+    PIN_HANDLER_FNS[handler.kind](handler, event);
+}
+
+// After the queue overflowed: once every event queued before the loss is
+// handled, starts each handler that lost one over from its pins. The input
+// interrupt is held off meanwhile, so no edge can land between the queue
+// running dry and the pins being read. Call from the input loop after
+// draining.
+void resync_dropped_inputs() {
+    if (!has_dropped_pins()) [[likely]] {
+        return;
+    }
+    const uint32_t interrupts = save_and_disable_interrupts();
+    const uint32_t levels = gpio_get_all();
+    for (uint32_t pins = take_dropped_pins_if_drained(); pins != 0; pins &= pins - 1) {
+        const PinHandler handler = PIN_HANDLERS[__builtin_ctz(pins)];
+        PIN_RESYNC_FNS[handler.kind](handler, levels);
+    }
+    restore_interrupts(interrupts);
+}
+
+// Starts every handler over from one read of the pins, drops whatever was
+// queued before it, and returns the read. A pin that moved since the
+// handlers' first read in init_input_handlers() then can not leave its
+// handler behind. Call once on the input core, after enabling the input
+// interrupt so later edges queue, or before init_input_scan() with what it
+// returns so the scan starts from the same levels.
+uint32_t capture_input_state() {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    const uint32_t levels = gpio_get_all();
+    reset_event_queue();
+    for (uint32_t pins = CONTROLLER_IRQ_MASK; pins != 0; pins &= pins - 1) {
+        const PinHandler handler = PIN_HANDLERS[__builtin_ctz(pins)];
+        PIN_RESYNC_FNS[handler.kind](handler, levels);
+    }
+    restore_interrupts(interrupts);
+    return levels;
+}
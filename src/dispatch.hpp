@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "const.hpp"
+#include "event.hpp"
+
+enum PinHandlerKind {
+    NO_HANDLER = 0,
+    ROTARY_ENCODER_HANDLER,
+    BUTTON_HANDLER,
+    NUM_PIN_HANDLER_KINDS,
+};
+
+enum PinRole {
+    ROLE_LEFT = 0,
+    ROLE_RIGHT,
+    ROLE_BUTTON,
+};
+
+#define MAX_PIN_HANDLER_INDEX 15
+
+// Everything the event loop needs to route an edge, packed into one byte so
+// a lookup is a single load.
+struct PinHandler {
+    uint8_t kind : 2;
+    uint8_t role : 2;
+    uint8_t index : 4;
+};
+
+static_assert(sizeof(PinHandler) == 1, "PinHandler should pack into one byte");
+static_assert(NUM_PIN_HANDLER_KINDS <= 4, "PinHandler::kind is only two bits wide");
+
+// The IO_IRQ_BANK0 status registers hold four bits per pin (level low,
+// level high, edge low, edge high), eight pins to a register
+#define GPIO_IRQ_PINS_PER_REGISTER 8
+#define GPIO_IRQ_STATUS_REGISTERS 4
+
+typedef void (*PinHandlerFn)(PinHandler handler, const Event &event);
+typedef void (*PinResyncFn)(PinHandler handler, uint32_t levels);
+
+void init_input_handlers();
+void enable_input_irq();
+void input_irq_handler();
+bool is_pin_registered(uint pin);
+void dispatch_event(const Event &event);
+void resync_dropped_inputs();
+uint32_t capture_input_state();
@@ -1,11 +1,121 @@
+#include <atomic>
 #include "event.hpp"
+#include "instrumentation.hpp"
+
+static SPSCRingQueue<Event, EVENT_BUFFER_LENGTH> EVENT_QUEUE;
+
+// Producer side writes all three, the consumer only clears DROPPED_PINS with
+// the producer held off
+static std::atomic<uint32_t> DROPPED_PINS { 0 };
+static std::atomic<uint32_t> CANCELLED_PAIRS { 0 };
+static std::atomic<uint32_t> DROPPED_EVENTS { 0 };
+static std::atomic<uint32_t> PAIR_WINDOW_US { EVENT_DEFAULT_PAIR_WINDOW_US };
 
 void record_event(uint gpio, uint32_t mask) {
-    [[unlikely]] if (!EVENT_QUEUE.push(Event(gpio, mask))) {
-        panic("Event buffer overflowed!");
+    push_event(Event(gpio, mask));
+}
+
+static bool is_single_edge(uint32_t mask) {
+    return mask == GPIO_IRQ_EDGE_RISE || mask == GPIO_IRQ_EDGE_FALL;
+}
+
+// Takes back the newest queued event if this one undoes it, deep enough in
+// overload that no drain can be looking at it
+static bool __not_in_flash_func(cancel_edge_pair)(const Event &event) {
+    const Event* newest = EVENT_QUEUE.peek_newest(EVENT_OVERLOAD_DEPTH);
+    if (newest == nullptr || newest->gpio() != event.gpio()
+        || !is_single_edge(event.mask()) || newest->mask() != (event.mask() ^ EVENT_EDGE_BITS)
+        || event.time - newest->time >= PAIR_WINDOW_US.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    EVENT_QUEUE.drop_newest();
+    CANCELLED_PAIRS.store(CANCELLED_PAIRS.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static void __not_in_flash_func(drop_event)(const Event &event) {
+    DROPPED_PINS.store(DROPPED_PINS.load(std::memory_order_relaxed) | (1u << event.gpio()), std::memory_order_release);
+    DROPPED_EVENTS.store(DROPPED_EVENTS.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    instrument_event_dropped();
+}
+
+void __not_in_flash_func(push_event)(const Event &event) {
+    if (cancel_edge_pair(event)) {
+        return;
+    }
+    [[unlikely]] if (!EVENT_QUEUE.push(event)) {
+        drop_event(event);
+        return;
     }
+    #ifdef INSTRUMENTATION
+    instrument_queue_depth(EVENT_QUEUE.get_len());
+    #endif
+}
+
+// All or nothing below the overload depth, so the consumer never sees half
+// an interrupt's edges. Past it every edge gets its chance to cancel.
+void __not_in_flash_func(push_events)(const Event* events, uint num_events) {
+    [[unlikely]] if (EVENT_QUEUE.get_len() >= EVENT_OVERLOAD_DEPTH || !EVENT_QUEUE.push_batch(events, num_events)) {
+        for (uint i = 0; i < num_events; ++i) {
+            push_event(events[i]);
+        }
+        return;
+    }
+    #ifdef INSTRUMENTATION
+    instrument_queue_depth(EVENT_QUEUE.get_len());
+    #endif
 }
 
 std::optional<Event> pop_event() {
     return EVENT_QUEUE.pop();
 }
+
+// At most EVENT_DRAIN_BATCH_LENGTH at a time, which keeps every copy clear of
+// the events overload may still take back
+uint pop_events(Event* out, uint max_len) {
+    return EVENT_QUEUE.pop_batch(out, max_len < EVENT_DRAIN_BATCH_LENGTH ? max_len : EVENT_DRAIN_BATCH_LENGTH);
+}
+
+bool has_pending_events() {
+    return EVENT_QUEUE.get_len() != 0;
+}
+
+bool has_dropped_pins() {
+    return DROPPED_PINS.load(std::memory_order_acquire) != 0;
+}
+
+// Consumer side, with the producer held off. The pins that lost an event,
+// or 0 while events queued before the loss are still waiting.
+uint32_t take_dropped_pins_if_drained() {
+    if (EVENT_QUEUE.get_len() != 0) {
+        return 0;
+    }
+    const uint32_t pins = DROPPED_PINS.load(std::memory_order_acquire);
+    DROPPED_PINS.store(0, std::memory_order_relaxed);
+    return pins;
+}
+
+// 0 turns cancelling off
+void set_event_pair_window_us(uint32_t window_us) {
+    PAIR_WINDOW_US.store(window_us, std::memory_order_relaxed);
+}
+
+uint32_t get_event_pair_window_us() {
+    return PAIR_WINDOW_US.load(std::memory_order_relaxed);
+}
+
+EventQueueStats get_event_queue_stats() {
+    return EventQueueStats {
+        CANCELLED_PAIRS.load(std::memory_order_relaxed),
+        DROPPED_EVENTS.load(std::memory_order_relaxed),
+    };
+}
+
+// Consumer side, with the producer held off. Empties the queue and forgets
+// every drop, as if nothing had been queued yet.
+void reset_event_queue() {
+    EVENT_QUEUE.reset();
+    DROPPED_PINS.store(0, std::memory_order_relaxed);
+    CANCELLED_PAIRS.store(0, std::memory_order_relaxed);
+    DROPPED_EVENTS.store(0, std::memory_order_relaxed);
+}
@@ -3,30 +3,78 @@
 #include "pico/stdlib.h"
 #include "buffer.hpp"
 
-#define EVENT_BUFFER_LENGTH 2048
+#define EVENT_BUFFER_LENGTH 2048  // Must be a power of two
+#define EVENT_DRAIN_BATCH_LENGTH 32
+#define EVENT_OVERLOAD_DEPTH 512  // Queued events past which opposite edges start cancelling
+#define EVENT_DEFAULT_PAIR_WINDOW_US 200
+#define EVENT_PAIR_WINDOW_UNIT_US 4  // As the tuning report sets it
+#define EVENT_MAX_PAIR_WINDOW_US (255 * EVENT_PAIR_WINDOW_UNIT_US)
 
+#define EVENT_GPIO_BITS 0x1Fu
+#define EVENT_EDGE_BITS (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE)
+#define EVENT_EDGE_SHIFT 3
+
+// 12 bytes per event: the low 32 bits of the microsecond timer, the level of
+// every pin as sampled in the ISR, and the pin number (bits 0-4) packed with
+// its edge bits (bits 5-6) in one byte. Timestamps wrap every ~71 minutes, so
+// only ever compare them by unsigned 32-bit difference.
 class Event {
 public:
-    uint gpio;
-    uint32_t mask;
-    uint64_t time;
+    uint32_t time;
+    uint32_t levels;
+    uint8_t gpio_and_edges;
 
     Event(uint gpio, uint32_t mask):
-        gpio(gpio),
-        mask(mask),
-        time(time_us_64())
+        time(time_us_32()),
+        levels(gpio_get_all()),
+        gpio_and_edges((gpio & EVENT_GPIO_BITS) | ((mask & EVENT_EDGE_BITS) << EVENT_EDGE_SHIFT))
+    {}
+
+    // An edge the caller already timed and sampled, like a scan pass
+    Event(uint gpio, uint32_t mask, uint32_t time, uint32_t levels):
+        time(time),
+        levels(levels),
+        gpio_and_edges((gpio & EVENT_GPIO_BITS) | ((mask & EVENT_EDGE_BITS) << EVENT_EDGE_SHIFT))
     {}
 
     Event():
-        gpio(0),
-        mask(0),
-        time(0)
+        time(0),
+        levels(0),
+        gpio_and_edges(0)
     {}
 
+    uint gpio() const {
+        return gpio_and_edges & EVENT_GPIO_BITS;
+    }
+
+    uint32_t mask() const {
+        return (gpio_and_edges >> EVENT_EDGE_SHIFT) & EVENT_EDGE_BITS;
+    }
 };
 
-static Event EVENT_BUFFER[EVENT_BUFFER_LENGTH];
-static CircularBufferFIFOQueue<Event> EVENT_QUEUE = CircularBufferFIFOQueue(EVENT_BUFFER, EVENT_BUFFER_LENGTH);
+static_assert(sizeof(Event) == 12, "Event should pack into 12 bytes");
+static_assert(EVENT_OVERLOAD_DEPTH >= EVENT_DRAIN_BATCH_LENGTH, "Edges are only cancelled out of a drain's reach");
+static_assert(EVENT_OVERLOAD_DEPTH + 32 <= EVENT_BUFFER_LENGTH, "A whole interrupt's batch must fit below the overload depth");
+
+// Overload. Past EVENT_OVERLOAD_DEPTH queued events, an edge that undoes the
+// last queued one on the same pin within the pair window takes it back
+// instead of queueing, so a chattering contact stops growing the queue. An
+// edge that finds the queue full is dropped and counted, and its pin is
+// resynchronised once the queue has drained.
+struct EventQueueStats {
+    uint32_t cancelled_pairs;
+    uint32_t dropped_events;
+};
 
 void record_event(uint gpio, uint32_t mask);
+void push_event(const Event &event);
+void push_events(const Event* events, uint num_events);
 std::optional<Event> pop_event();
+uint pop_events(Event* out, uint max_len);
+bool has_pending_events();
+bool has_dropped_pins();
+uint32_t take_dropped_pins_if_drained();
+void set_event_pair_window_us(uint32_t window_us);
+uint32_t get_event_pair_window_us();
+EventQueueStats get_event_queue_stats();
+void reset_event_queue();
@@ -0,0 +1,101 @@
+#include <atomic>
+#include <string.h>
+#include "flight_recorder.hpp"
+
+#ifdef FLIGHT_RECORDER
+// Written by the input side only. FLIGHT_RECORDER_HEAD counts every record
+// ever written; the USB side only reads records below it.
+static FlightRecord FLIGHT_RECORDS[FLIGHT_RECORDER_LENGTH];
+static std::atomic<uint32_t> FLIGHT_RECORDER_HEAD { 0 };
+static std::atomic<bool> FLIGHT_RECORDER_FROZEN { false };
+
+// USB side
+static uint32_t FLIGHT_RECORDER_START = 0;  // Head at the last clear
+static uint32_t DUMP_NEXT = 0;
+static uint32_t DUMP_END = 0;
+static bool DUMPING = false;
+
+void record_flight(uint encoder, const Event &event, RotaryEncoderState before, RotaryEncoderState after, RotaryEncoderDecision decision) {
+    if (FLIGHT_RECORDER_FROZEN.load(std::memory_order_acquire)) [[unlikely]] {
+        return;
+    }
+    const uint32_t head = FLIGHT_RECORDER_HEAD.load(std::memory_order_relaxed);
+    FLIGHT_RECORDS[head & (FLIGHT_RECORDER_LENGTH - 1)] = FlightRecord {
+        event.time,
+        event.gpio_and_edges,
+        pack_flight_record_states(before, after),
+        (uint8_t)decision,
+        (uint8_t)encoder,
+    };
+    FLIGHT_RECORDER_HEAD.store(head + 1, std::memory_order_release);
+}
+
+static void begin_dump() {
+    FLIGHT_RECORDER_FROZEN.store(true, std::memory_order_seq_cst);
+    const uint32_t head = FLIGHT_RECORDER_HEAD.load(std::memory_order_acquire);
+    // A record that missed the freeze may still be landing in the slot at
+    // head, which once full is the oldest one, so that slot is left out
+    uint32_t available = head - FLIGHT_RECORDER_START;
+    if (available > FLIGHT_RECORDER_LENGTH - 1) {
+        available = FLIGHT_RECORDER_LENGTH - 1;
+    }
+    DUMP_NEXT = head - available;
+    DUMP_END = head;
+    DUMPING = true;
+}
+
+static void end_dump() {
+    DUMPING = false;
+    FLIGHT_RECORDER_FROZEN.store(false, std::memory_order_release);
+}
+
+uint16_t get_flight_recorder_report(uint8_t* buffer, uint16_t reqlen) {
+    if (!DUMPING) {
+        begin_dump();
+    }
+    FlightRecorderPage page;
+    memset(&page, 0, sizeof(page));
+    page.version = FLIGHT_RECORDER_VERSION;
+    page.debounce_count = get_rotary_encoder_debounce_count();
+    page.consensus_count = get_rotary_encoder_consensus_count();
+    page.total_records = DUMP_END - FLIGHT_RECORDER_START;
+    uint num_records = 0;
+    while (num_records < FLIGHT_RECORDER_PAGE_RECORDS && DUMP_NEXT != DUMP_END) {
+        page.records[num_records++] = FLIGHT_RECORDS[DUMP_NEXT++ & (FLIGHT_RECORDER_LENGTH - 1)];
+    }
+    page.num_records = num_records;
+    if (num_records == 0) {
+        end_dump();
+    }
+    uint16_t len = sizeof(page);
+    if (len > reqlen) {
+        len = reqlen;
+    }
+    memcpy(buffer, &page, len);
+    return len;
+}
+
+void command_flight_recorder(const uint8_t* buffer, uint16_t len) {
+    if (len < 1) {
+        return;
+    }
+    if (buffer[0] == FLIGHT_RECORDER_CLEAR) {
+        FLIGHT_RECORDER_START = FLIGHT_RECORDER_HEAD.load(std::memory_order_acquire);
+    }
+    end_dump();
+}
+
+// Dumps the pages as hex, one per line, for debug builds where the USB
+// carries stdio instead of HID. `xxd -r -p` turns it back into a dump file.
+void print_flight_recorder() {
+    FlightRecorderPage page;
+    do {
+        get_flight_recorder_report((uint8_t*)&page, sizeof(page));
+        const uint8_t* bytes = (const uint8_t*)&page;
+        for (uint i = 0; i < sizeof(page); ++i) {
+            printf("%02x", bytes[i]);
+        }
+        printf("\n");
+    } while (page.num_records != 0);
+}
+#endif
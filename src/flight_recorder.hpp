@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "event.hpp"
+#include "rotary_encoder.hpp"
+
+#define FLIGHT_RECORDER_REPORT_ID 9  // Must match desc_hid_report
+#define FLIGHT_RECORDER_VERSION 1  // Bump whenever FlightRecord or FlightRecorderPage changes shape
+#define FLIGHT_RECORDER_LENGTH 1024  // Must be a power of two, 8 bytes per record
+#define FLIGHT_RECORDER_PAGE_RECORDS 6
+
+static_assert((FLIGHT_RECORDER_LENGTH & (FLIGHT_RECORDER_LENGTH - 1)) == 0, "FLIGHT_RECORDER_LENGTH must be a power of two");
+
+// First byte of a SET_REPORT on the flight recorder report
+enum FlightRecorderCommand {
+    FLIGHT_RECORDER_REWIND = 0,  // Abandon the dump in progress and resume recording
+    FLIGHT_RECORDER_CLEAR = 1,  // Same, and forget everything recorded so far
+};
+
+// One decoded encoder edge: the raw event as queued by the ISR and what the
+// decoder made of it. The state after decoding is always the sampled state,
+// which is all a replay needs to feed the decoder again.
+struct FlightRecord {
+    uint32_t time;
+    uint8_t gpio_and_edges;  // As in Event
+    uint8_t states;  // RotaryEncoderState before decoding in bits 0-3, after in bits 4-7
+    uint8_t decision;  // RotaryEncoderDecision
+    uint8_t encoder;
+};
+
+static_assert(sizeof(FlightRecord) == 8, "FlightRecord should pack into 8 bytes");
+
+// A dump is a run of these, read one GET_REPORT at a time, oldest record
+// first. The first read freezes the recorder and the page with no records
+// ends the dump and resumes recording. Saved back to back (without the
+// report ID) they make the file the host replay tool reads.
+struct FlightRecorderPage {
+    uint8_t version;
+    uint8_t num_records;
+    uint8_t debounce_count;  // Encoder tuning in use when the page was read
+    uint8_t consensus_count;
+    uint32_t total_records;  // Since the last clear, including those overwritten
+    FlightRecord records[FLIGHT_RECORDER_PAGE_RECORDS];
+};
+
+static_assert(sizeof(FlightRecorderPage) == 56, "FlightRecorderPage must match its report descriptor");
+
+static inline uint8_t pack_flight_record_states(RotaryEncoderState before, RotaryEncoderState after) {
+    return (uint8_t)(before | (after << 4));
+}
+
+static inline RotaryEncoderState flight_record_state_before(const FlightRecord &record) {
+    return (RotaryEncoderState)(record.states & 0xF);
+}
+
+static inline RotaryEncoderState flight_record_state_after(const FlightRecord &record) {
+    return (RotaryEncoderState)(record.states >> 4);
+}
+
+#ifdef FLIGHT_RECORDER
+// Input side
+void record_flight(uint encoder, const Event &event, RotaryEncoderState before, RotaryEncoderState after, RotaryEncoderDecision decision);
+
+// USB side
+uint16_t get_flight_recorder_report(uint8_t* buffer, uint16_t reqlen);
+void command_flight_recorder(const uint8_t* buffer, uint16_t len);
+void print_flight_recorder();
+#else
+// Compiled out, every hook is an empty inline
+static inline void record_flight(uint encoder, const Event &event, RotaryEncoderState before, RotaryEncoderState after, RotaryEncoderDecision decision) {
+    (void)encoder;
+    (void)event;
+    (void)before;
+    (void)after;
+    (void)decision;
+}
+static inline uint16_t get_flight_recorder_report(uint8_t* buffer, uint16_t reqlen) {
+    (void)buffer;
+    (void)reqlen;
+    return 0;
+}
+static inline void command_flight_recorder(const uint8_t* buffer, uint16_t len) { (void)buffer; (void)len; }
+static inline void print_flight_recorder() { }
+#endif
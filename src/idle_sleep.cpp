@@ -0,0 +1,52 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "button.hpp"
+#include "event.hpp"
+#include "idle_sleep.hpp"
+#include "rotary_encoder.hpp"
+#include "tuning.hpp"
+
+// Sleeps until the next interrupt or __sev() unless has_work() finds
+// something to do, and returns whether it slept. Interrupts stay masked from
+// the check until WFE, so one that lands in between is not slept through:
+// becoming pending sets the event register and WFE returns at once. It runs
+// as soon as interrupts are restored.
+bool sleep_unless(bool (*has_work)()) {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    const bool sleeping = !has_work();
+    if (sleeping) {
+        __wfe();
+    }
+    restore_interrupts(interrupts);
+    return sleeping;
+}
+
+// Input side: queued events, or state that only time moves on. Button
+// lockouts end in settle_buttons(), not on an edge.
+bool input_has_work() {
+    return has_pending_events() || has_dropped_pins() || !buttons_are_settled() || is_tuning_pending();
+}
+
+// Input side: decoded but not yet in a report
+bool input_has_changes(Joystick* stick) {
+    return stick->has_changes() || buttons_have_changes() || rotary_encoders_have_pending_ticks();
+}
+
+// USB side: tinyusb has events queued, or the endpoint is free for a report
+// that would differ from the last one. A busy endpoint frees up through the
+// USB interrupt, which queues an event.
+bool usb_has_work(ReportScheduler &scheduler, bool usb_event_ready, bool endpoint_ready, bool inputs_changed) {
+    if (usb_event_ready) {
+        return true;
+    }
+    return !scheduler.is_busy() && endpoint_ready && (inputs_changed || scheduler.dirty_fields() != 0);
+}
+
+// Core 1 under DUAL_CORE, which hands every change to core 0
+bool input_core_has_work(Joystick* stick) {
+    return input_has_work() || input_has_changes(stick);
+}
+
+bool main_loop_has_work(Joystick* stick, ReportScheduler &scheduler, bool usb_event_ready, bool endpoint_ready) {
+    return input_has_work() || usb_has_work(scheduler, usb_event_ready, endpoint_ready, input_has_changes(stick));
+}
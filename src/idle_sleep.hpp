@@ -0,0 +1,15 @@
+#pragma once
+#include "joystick.hpp"
+#include "report_scheduler.hpp"
+
+// The checks an IDLE_SLEEP build makes, with interrupts masked, before it
+// lets a core sleep with WFE. Each is true while the loop still has something
+// to do that no interrupt would announce. The USB state comes in as
+// arguments, so the checks build without tinyusb.
+
+bool sleep_unless(bool (*has_work)());
+bool input_has_work();
+bool input_has_changes(Joystick* stick);
+bool usb_has_work(ReportScheduler &scheduler, bool usb_event_ready, bool endpoint_ready, bool inputs_changed);
+bool input_core_has_work(Joystick* stick);
+bool main_loop_has_work(Joystick* stick, ReportScheduler &scheduler, bool usb_event_ready, bool endpoint_ready);
@@ -0,0 +1,226 @@
+#include <string.h>
+#include "instrumentation.hpp"
+#include "hardware/structs/systick.h"
+
+#ifdef INSTRUMENTATION
+static uint32_t LATENCY_HISTOGRAMS[NUM_LATENCY_STAGES][LATENCY_HISTOGRAM_BUCKETS];
+static InstrumentationCounters COUNTERS;
+
+// Decoded but not yet staged. Only the input side touches it
+static LatencyStamp DECODED_STAMP;
+// Staged but not yet sent, and on the bus. Only the USB side touches them
+static LatencyStamp STAGED_STAMP;
+static LatencyStamp IN_FLIGHT_STAMP;
+static uint32_t IN_FLIGHT_SENT_TIME;
+static bool BUSY_COUNTED;  // The current transfer already held up some input
+// Only the input core's interrupt touches these
+static IsrCycleCounters ISR_CYCLES;
+static uint32_t ISR_SEGMENT_START;  // SysTick when the interrupt or its last callback began
+static uint32_t ISR_CYCLES_THIS_INTERRUPT;
+// The interrupt stamps, the input loop clears. Both run on the input core
+static WakeCounters WAKES;
+static uint32_t FIRST_UNPICKED_EXIT;  // SysTick
+static volatile bool UNPICKED_EVENTS;
+
+static void record_latency(LatencyStage stage, uint32_t latency_us) {
+    ++LATENCY_HISTOGRAMS[stage][latency_bucket(latency_us)];
+}
+
+// Keeps whichever stamp holds the older input. Wrap-safe as long as the two
+// are less than ~35 minutes apart.
+void merge_latency_stamp(LatencyStamp &into, const LatencyStamp &stamp) {
+    if (!stamp.valid) {
+        return;
+    }
+    if (!into.valid || (int32_t)(stamp.isr_time - into.isr_time) < 0) {
+        into = stamp;
+    }
+}
+
+uint latency_bucket(uint32_t latency_us) {
+    if (latency_us == 0) {
+        return 0;
+    }
+    const uint bucket = 32 - __builtin_clz(latency_us);  // Bit length
+    return bucket < LATENCY_HISTOGRAM_BUCKETS ? bucket : LATENCY_HISTOGRAM_BUCKETS - 1;
+}
+
+void instrument_queue_depth(uint depth) {
+    if (depth > COUNTERS.queue_high_water) {
+        COUNTERS.queue_high_water = depth;
+    }
+}
+
+void instrument_event_dropped() {
+    ++COUNTERS.events_dropped;
+}
+
+// Free-runs SysTick at the core clock, without its interrupt. Each core has
+// its own, so call this on the core that takes the GPIO interrupt.
+void init_isr_cycle_counter() {
+    systick_hw->csr = 0;
+    systick_hw->rvr = ISR_CYCLE_COUNTER_WRAP;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+void __not_in_flash_func(instrument_isr_enter)() {
+    ISR_SEGMENT_START = systick_hw->cvr;
+    ISR_CYCLES_THIS_INTERRUPT = 0;
+    ++ISR_CYCLES.interrupts;
+}
+
+// Charges the cycles since entry, or since the last exit in the same
+// interrupt, so a handler that calls back once per pin can exit per call
+void __not_in_flash_func(instrument_isr_exit)(uint num_edges) {
+    const uint32_t now = systick_hw->cvr;
+    const uint32_t cycles = (ISR_SEGMENT_START - now) & ISR_CYCLE_COUNTER_WRAP;  // Counts down
+    ISR_SEGMENT_START = now;
+    ISR_CYCLES_THIS_INTERRUPT += cycles;
+    ISR_CYCLES.total_cycles += cycles;
+    ISR_CYCLES.edges += num_edges;
+    if (ISR_CYCLES_THIS_INTERRUPT > ISR_CYCLES.max_cycles) {
+        ISR_CYCLES.max_cycles = ISR_CYCLES_THIS_INTERRUPT;
+    }
+    if (num_edges > 0 && !UNPICKED_EVENTS) {
+        FIRST_UNPICKED_EXIT = now;
+        UNPICKED_EVENTS = true;
+    }
+}
+
+void instrument_idle_sleep() {
+    ++WAKES.sleeps;
+}
+
+// Called once the input loop popped events. Pickups longer than a SysTick
+// wrap, ~134 ms at 125 MHz, alias, which only a stalled loop gets near.
+void instrument_events_picked_up() {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    if (UNPICKED_EVENTS) {
+        const uint32_t cycles = (FIRST_UNPICKED_EXIT - systick_hw->cvr) & ISR_CYCLE_COUNTER_WRAP;  // Counts down
+        UNPICKED_EVENTS = false;
+        ++WAKES.pickups;
+        WAKES.total_pickup_cycles += cycles;
+        if (cycles > WAKES.max_pickup_cycles) {
+            WAKES.max_pickup_cycles = cycles;
+        }
+    }
+    restore_interrupts(interrupts);
+}
+
+void instrument_events_decoded(const Event* events, uint num_events) {
+    if (num_events == 0) {
+        return;
+    }
+    const uint32_t now = time_us_32();
+    for (uint i = 0; i < num_events; ++i) {
+        record_latency(LATENCY_STAGE_QUEUE, now - events[i].time);
+    }
+    // Events leave the queue in order, so the first one is the oldest
+    merge_latency_stamp(DECODED_STAMP, LatencyStamp { events[0].time, now, true });
+}
+
+LatencyStamp take_decoded_latency_stamp() {
+    const LatencyStamp stamp = DECODED_STAMP;
+    DECODED_STAMP.valid = false;
+    return stamp;
+}
+
+void stage_latency_stamp(const LatencyStamp &stamp) {
+    merge_latency_stamp(STAGED_STAMP, stamp);
+}
+
+void instrument_endpoint_busy() {
+    if (STAGED_STAMP.valid && !BUSY_COUNTED) {
+        ++COUNTERS.reports_skipped;
+        BUSY_COUNTED = true;
+    }
+}
+
+void instrument_report_sent(uint32_t now) {
+    if (STAGED_STAMP.valid) {
+        record_latency(LATENCY_STAGE_STAGING, now - STAGED_STAMP.decode_time);
+    }
+    IN_FLIGHT_STAMP = STAGED_STAMP;
+    IN_FLIGHT_SENT_TIME = now;
+    STAGED_STAMP.valid = false;
+    BUSY_COUNTED = false;
+}
+
+void instrument_report_refused() {
+    ++COUNTERS.reports_skipped;
+}
+
+// Nothing the host can see changed, so the staged input will never be sent
+void instrument_report_unchanged() {
+    STAGED_STAMP.valid = false;
+}
+
+void instrument_report_complete(uint32_t now) {
+    ++COUNTERS.reports_completed;
+    if (IN_FLIGHT_STAMP.valid) {
+        record_latency(LATENCY_STAGE_BUS, now - IN_FLIGHT_SENT_TIME);
+        record_latency(LATENCY_STAGE_END_TO_END, now - IN_FLIGHT_STAMP.isr_time);
+        IN_FLIGHT_STAMP.valid = false;
+    }
+}
+
+void reset_instrumentation() {
+    memset(LATENCY_HISTOGRAMS, 0, sizeof(LATENCY_HISTOGRAMS));
+    COUNTERS = InstrumentationCounters { 0, 0, 0, 0 };
+    DECODED_STAMP.valid = false;
+    STAGED_STAMP.valid = false;
+    IN_FLIGHT_STAMP.valid = false;
+    BUSY_COUNTED = false;
+    ISR_CYCLES = IsrCycleCounters { 0, 0, 0, 0 };
+    WAKES = WakeCounters { 0, 0, 0, 0 };
+    UNPICKED_EVENTS = false;
+}
+
+const uint32_t* get_latency_histogram(LatencyStage stage) {
+    return LATENCY_HISTOGRAMS[stage];
+}
+
+const InstrumentationCounters& get_instrumentation_counters() {
+    return COUNTERS;
+}
+
+const IsrCycleCounters& get_isr_cycle_counters() {
+    return ISR_CYCLES;
+}
+
+const WakeCounters& get_wake_counters() {
+    return WAKES;
+}
+
+// Fills a GET_REPORT(Feature) response, little endian like the core. Returns
+// 0 for report IDs that are not ours, which STALLs the request.
+uint16_t get_instrumentation_report(uint8_t report_id, uint8_t* buffer, uint16_t reqlen) {
+    const void* source;
+    uint16_t len;
+    if (report_id == INSTRUMENTATION_COUNTERS_REPORT_ID) {
+        source = &COUNTERS;
+        len = sizeof(COUNTERS);
+    }
+    else if (report_id >= INSTRUMENTATION_HISTOGRAM_REPORT_ID && report_id < INSTRUMENTATION_HISTOGRAM_REPORT_ID + NUM_LATENCY_STAGES) {
+        source = LATENCY_HISTOGRAMS[report_id - INSTRUMENTATION_HISTOGRAM_REPORT_ID];
+        len = sizeof(LATENCY_HISTOGRAMS[0]);
+    }
+    else if (report_id == INSTRUMENTATION_ISR_REPORT_ID) {
+        source = &ISR_CYCLES;
+        len = sizeof(ISR_CYCLES);
+    }
+    else if (report_id == INSTRUMENTATION_WAKE_REPORT_ID) {
+        source = &WAKES;
+        len = sizeof(WAKES);
+    }
+    else {
+        return 0;
+    }
+    if (len > reqlen) {
+        len = reqlen;
+    }
+    memcpy(buffer, source, len);
+    return len;
+}
+#endif
@@ -0,0 +1,117 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "event.hpp"
+
+// Feature report IDs, must match desc_hid_report
+#define INSTRUMENTATION_COUNTERS_REPORT_ID 3
+#define INSTRUMENTATION_HISTOGRAM_REPORT_ID 4  // One ID per LatencyStage from here on
+#define INSTRUMENTATION_ISR_REPORT_ID 10
+#define INSTRUMENTATION_WAKE_REPORT_ID 11
+
+#define ISR_CYCLE_COUNTER_WRAP 0x00FFFFFFu  // SysTick is a 24-bit down counter
+
+// Bucket 0 holds 0 us, bucket n holds [2^(n-1), 2^n) us and the last bucket
+// everything from 2^(LATENCY_HISTOGRAM_BUCKETS - 2) us up. 15 32-bit buckets
+// plus the report ID fill one 64 byte control transfer.
+#define LATENCY_HISTOGRAM_BUCKETS 15
+
+enum LatencyStage {
+    LATENCY_STAGE_QUEUE,  // ISR entry -> decoded
+    LATENCY_STAGE_STAGING,  // Decoded -> tud_hid_n_report
+    LATENCY_STAGE_BUS,  // tud_hid_n_report -> tud_hid_report_complete_cb
+    LATENCY_STAGE_END_TO_END,  // ISR entry -> tud_hid_report_complete_cb
+    NUM_LATENCY_STAGES,
+};
+
+// The oldest input folded into a report, so the report that finally carries
+// it can be timed. Reports carry many edges, the first one waited longest.
+struct LatencyStamp {
+    #ifdef INSTRUMENTATION
+    uint32_t isr_time;
+    uint32_t decode_time;
+    bool valid;
+    #endif
+};
+
+#ifdef INSTRUMENTATION
+struct InstrumentationCounters {
+    uint32_t queue_high_water;
+    uint32_t events_dropped;
+    uint32_t reports_skipped;  // Input waited on a busy endpoint, or the send was refused
+    uint32_t reports_completed;
+};
+
+// Cycles spent in the GPIO interrupt, timed with the input core's SysTick.
+// The total wraps, so read it twice and take the difference.
+struct IsrCycleCounters {
+    uint32_t interrupts;
+    uint32_t edges;
+    uint32_t total_cycles;
+    uint32_t max_cycles;  // In any one interrupt
+};
+
+// How long queued edges wait for the input loop to pick them up, in SysTick
+// cycles from the end of the first interrupt that queued any. Compare builds
+// with and without IDLE_SLEEP to see what waking from WFE costs.
+struct WakeCounters {
+    uint32_t sleeps;  // Times the input loop went to sleep
+    uint32_t pickups;
+    uint32_t total_pickup_cycles;
+    uint32_t max_pickup_cycles;
+};
+
+// Producer (ISR) side
+void instrument_queue_depth(uint depth);
+void instrument_event_dropped();
+void init_isr_cycle_counter();
+void instrument_isr_enter();
+void instrument_isr_exit(uint num_edges);
+
+// Input side: decoding
+void instrument_idle_sleep();
+void instrument_events_picked_up();
+void instrument_events_decoded(const Event* events, uint num_events);
+LatencyStamp take_decoded_latency_stamp();
+
+// USB side: reports. In single core mode both sides are the main loop
+void merge_latency_stamp(LatencyStamp &into, const LatencyStamp &stamp);
+void stage_latency_stamp(const LatencyStamp &stamp);
+void instrument_endpoint_busy();
+void instrument_report_sent(uint32_t now);
+void instrument_report_refused();
+void instrument_report_unchanged();
+void instrument_report_complete(uint32_t now);
+
+void reset_instrumentation();
+uint latency_bucket(uint32_t latency_us);
+const uint32_t* get_latency_histogram(LatencyStage stage);
+const InstrumentationCounters& get_instrumentation_counters();
+const IsrCycleCounters& get_isr_cycle_counters();
+const WakeCounters& get_wake_counters();
+uint16_t get_instrumentation_report(uint8_t report_id, uint8_t* buffer, uint16_t reqlen);
+#else
+// Compiled out, every hook is an empty inline
+static inline void instrument_queue_depth(uint depth) { (void)depth; }
+static inline void instrument_event_dropped() { }
+static inline void init_isr_cycle_counter() { }
+static inline void instrument_isr_enter() { }
+static inline void instrument_isr_exit(uint num_edges) { (void)num_edges; }
+static inline void instrument_idle_sleep() { }
+static inline void instrument_events_picked_up() { }
+static inline void instrument_events_decoded(const Event* events, uint num_events) { (void)events; (void)num_events; }
+static inline LatencyStamp take_decoded_latency_stamp() { return LatencyStamp {}; }
+static inline void merge_latency_stamp(LatencyStamp &into, const LatencyStamp &stamp) { (void)into; (void)stamp; }
+static inline void stage_latency_stamp(const LatencyStamp &stamp) { (void)stamp; }
+static inline void instrument_endpoint_busy() { }
+static inline void instrument_report_sent(uint32_t now) { (void)now; }
+static inline void instrument_report_refused() { }
+static inline void instrument_report_unchanged() { }
+static inline void instrument_report_complete(uint32_t now) { (void)now; }
+static inline uint16_t get_instrumentation_report(uint8_t report_id, uint8_t* buffer, uint16_t reqlen) {
+    (void)report_id;
+    (void)buffer;
+    (void)reqlen;
+    return 0;
+}
+#endif
@@ -1,43 +1,77 @@
 #include "joystick.hpp"
 
-uint Joystick::num_joysticks = 0;
-
-Joystick::Joystick():
-    z(0),
-    rotation_x(0),
-    rotation_y(0),
-    rotation_z(0),
-    changed(false)
-{
-    if (num_joysticks >= MAX_JOYSTICKS) {
-        panic("Tried to create a joystick, but the maximum number of joysticks already exist!");
+static Joystick JOYSTICK;
+
+uint16_t Joystick::step_for_interval(uint32_t interval_us) {
+    uint32_t bucket = interval_us >> JOYSTICK_ACCELERATION_BUCKET_SHIFT;
+    if (bucket >= JOYSTICK_ACCELERATION_BUCKETS) {
+        bucket = JOYSTICK_ACCELERATION_BUCKETS - 1;
     }
-    num_joysticks;
+    return acceleration_curve.steps[bucket];
+}
+
+// Acceleration must not slow the axis down, and a zero step would freeze it
+bool Joystick::is_valid_sensitivity(uint sensitivity, uint max_sensitivity) {
+    return sensitivity >= 1 && max_sensitivity >= sensitivity && max_sensitivity <= JOYSTICK_MAX_TUNED_SENSITIVITY;
 }
 
-std::optional<Joystick*> Joystick::create_and_register() {
-    if (num_joysticks >= MAX_JOYSTICKS) {
-        return std::nullopt;
+bool Joystick::set_sensitivity(uint sensitivity, uint max_sensitivity) {
+    if (!is_valid_sensitivity(sensitivity, max_sensitivity)) {
+        return false;
     }
-    JOYSTICKS[num_joysticks] = Joystick();
-    return std::optional<Joystick*>{&JOYSTICKS[num_joysticks++].value()};
+    this->sensitivity = sensitivity;
+    this->max_sensitivity = max_sensitivity;
+    acceleration_curve = make_joystick_acceleration_curve(sensitivity, max_sensitivity);
+    return true;
 }
 
-void Joystick::handle_encoder_left_rotation() {
-    rotation_x = (rotation_x < JOYSTICK_SENSITIVITY) ? 0xFF - (JOYSTICK_SENSITIVITY - rotation_x) : rotation_x - JOYSTICK_SENSITIVITY;
-    changed = true;
+uint Joystick::get_sensitivity() {
+    return sensitivity;
 }
 
-void Joystick::handle_encoder_right_rotation() {
-    rotation_x = (rotation_x > 0xFF - JOYSTICK_SENSITIVITY) ? JOYSTICK_SENSITIVITY - (0xFF - rotation_x) : rotation_x + JOYSTICK_SENSITIVITY;
+uint Joystick::get_max_sensitivity() {
+    return max_sensitivity;
+}
+
+// Positive ticks turn right. interval_us is the average time per tick.
+void Joystick::handle_encoder_rotation(uint axis_slot, int32_t ticks, uint32_t interval_us) {
+    positions[axis_slot] += (uint32_t)(ticks * step_for_interval(interval_us));
     changed = true;
 }
 
 void Joystick::apply_to_report(report &report) {
-    report.joystick_rotation_x = rotation_x;
+    for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+        #ifdef DIAL_REPORT
+        report.axes[slot] = positions[slot];  // The scheduler sends the difference
+        #else
+        report.axes[slot] = positions[slot] >> REPORT_AXIS_SHIFT;  // Wraps with the axis
+        #endif
+    }
     changed = false;
 }
 
 bool Joystick::has_changes() {
     return changed;
 }
+
+// Centres every axis and restores the default sensitivity
+void init_joystick() {
+    JOYSTICK = Joystick();
+}
+
+Joystick* get_joystick() {
+    return &JOYSTICK;
+}
+
+// Returns false and changes nothing if the values are out of range
+bool set_joystick_sensitivity(uint sensitivity, uint max_sensitivity) {
+    return JOYSTICK.set_sensitivity(sensitivity, max_sensitivity);
+}
+
+uint get_joystick_sensitivity() {
+    return JOYSTICK.get_sensitivity();
+}
+
+uint get_joystick_max_sensitivity() {
+    return JOYSTICK.get_max_sensitivity();
+}
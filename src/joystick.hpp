@@ -1,30 +1,87 @@
 #pragma once
-#include <optional>
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "buffer.hpp"
 #include "report.hpp"
 
-#define JOYSTICK_SENSITIVITY 1
-#define MAX_JOYSTICKS 2
+// Sensitivities are axis steps per tick, in steps of the axis on the bus:
+// whole counts with 8-bit axes, 1/256ths of a count with
+// HIGH_RESOLUTION_AXES
+#ifdef HIGH_RESOLUTION_AXES
+typedef uint16_t JoystickSensitivity;
+#else
+typedef uint8_t JoystickSensitivity;
+#endif
+#define JOYSTICK_SENSITIVITY_PER_COUNT (256u >> REPORT_AXIS_SHIFT)
 
+#define JOYSTICK_SENSITIVITY (1 * JOYSTICK_SENSITIVITY_PER_COUNT)
+
+// Encoder ticks closer together than JOYSTICK_ACCELERATION_BUCKETS
+// buckets of (1 << JOYSTICK_ACCELERATION_BUCKET_SHIFT) us move the axis
+// further, up to JOYSTICK_ACCELERATION_MAX_SENSITIVITY for the fastest
+// bucket. Set the max equal to JOYSTICK_SENSITIVITY for a flat response.
+#define JOYSTICK_ACCELERATION_MAX_SENSITIVITY (16 * JOYSTICK_SENSITIVITY_PER_COUNT)
+#define JOYSTICK_ACCELERATION_BUCKETS 16
+#define JOYSTICK_ACCELERATION_BUCKET_SHIFT 8
+#define JOYSTICK_POSITION_FRACTION_BITS 8
+
+static_assert(JOYSTICK_ACCELERATION_MAX_SENSITIVITY >= JOYSTICK_SENSITIVITY, "Acceleration must not slow the axis down");
+
+#define JOYSTICK_MAX_TUNED_SENSITIVITY (255 * JOYSTICK_SENSITIVITY_PER_COUNT)  // A step of 255 counts still fits the 8.8 fixed point
+
+static_assert(JOYSTICK_MAX_TUNED_SENSITIVITY <= (JoystickSensitivity)~0u, "Every tunable sensitivity must fit JoystickSensitivity");
+
+// Axis step per tick in 1/256ths of a count, indexed by bucket. Falls
+// off quadratically from max_sensitivity to sensitivity.
+struct JoystickAccelerationCurve {
+    uint16_t steps[JOYSTICK_ACCELERATION_BUCKETS];
+};
+
+constexpr JoystickAccelerationCurve make_joystick_acceleration_curve(uint32_t sensitivity, uint32_t max_sensitivity) {
+    JoystickAccelerationCurve curve = {};
+    constexpr uint32_t unit = (1u << JOYSTICK_POSITION_FRACTION_BITS) / JOYSTICK_SENSITIVITY_PER_COUNT;
+    constexpr uint32_t slowest = JOYSTICK_ACCELERATION_BUCKETS - 1;
+    for (uint32_t bucket = 0; bucket < JOYSTICK_ACCELERATION_BUCKETS; ++bucket) {
+        uint32_t speed = slowest - bucket;
+        uint32_t boost = (max_sensitivity - sensitivity) * unit * speed * speed / (slowest * slowest);
+        curve.steps[bucket] = (uint16_t)(sensitivity * unit + boost);
+    }
+    return curve;
+}
+
+constexpr JoystickAccelerationCurve JOYSTICK_DEFAULT_ACCELERATION_CURVE = make_joystick_acceleration_curve(JOYSTICK_SENSITIVITY, JOYSTICK_ACCELERATION_MAX_SENSITIVITY);
+
+// Every axis of the report. Encoders bound to the same axis add up.
 class Joystick {
 private:
-    static uint num_joysticks;
-    uint8_t z;
-    uint8_t rotation_x;
-    uint8_t rotation_y;
-    uint8_t rotation_z;
+    uint32_t positions[CONTROLLER_NUM_AXES];  // Fixed point with 8 fraction bits, wraps, indexed by report slot
     bool changed;
+    JoystickSensitivity sensitivity;
+    JoystickSensitivity max_sensitivity;
+    JoystickAccelerationCurve acceleration_curve;
 
-    Joystick();
+    uint16_t step_for_interval(uint32_t interval_us);
 
 public:
-    static std::optional<Joystick*> create_and_register();
-    void handle_encoder_left_rotation();
-    void handle_encoder_right_rotation();
+    constexpr Joystick():
+        positions {},
+        changed(false),
+        sensitivity(JOYSTICK_SENSITIVITY),
+        max_sensitivity(JOYSTICK_ACCELERATION_MAX_SENSITIVITY),
+        acceleration_curve(JOYSTICK_DEFAULT_ACCELERATION_CURVE)
+    { }
+
+    static bool is_valid_sensitivity(uint sensitivity, uint max_sensitivity);
+    bool set_sensitivity(uint sensitivity, uint max_sensitivity);
+    uint get_sensitivity();
+    uint get_max_sensitivity();
+    void handle_encoder_rotation(uint axis_slot, int32_t ticks, uint32_t interval_us);
     void apply_to_report(report &report);
     bool has_changes();
 };
 
-static std::optional<Joystick> JOYSTICKS[MAX_JOYSTICKS];
+void init_joystick();
+Joystick* get_joystick();
+bool set_joystick_sensitivity(uint sensitivity, uint max_sensitivity);
+uint get_joystick_sensitivity();
+uint get_joystick_max_sensitivity();
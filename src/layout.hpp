@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include "const.hpp"
+#include "dispatch.hpp"
+
+#define LAYOUT_NUM_GPIOS 30  // Bank 0 on the RP2040
+#define LAYOUT_BUTTON_BITMAP_BITS 16  // Width of report::button_bitmap
+
+// Report axes in the order they appear in the input report. Only the axes
+// some encoder is bound to make it into the report.
+enum ControllerAxis {
+    AXIS_Z = 0,
+    AXIS_ROTATION_X,
+    AXIS_ROTATION_Y,
+    AXIS_ROTATION_Z,
+    NUM_CONTROLLER_AXES,
+};
+
+// Generic Desktop usage of each ControllerAxis
+constexpr uint8_t CONTROLLER_AXIS_USAGES[NUM_CONTROLLER_AXES] = { 0x32, 0x33, 0x34, 0x35 };
+
+struct EncoderLayout {
+    uint8_t gpio_left;
+    uint8_t gpio_right;
+    uint8_t axis;  // ControllerAxis
+};
+
+struct ButtonLayout {
+    uint8_t gpio;  // Button n is bit n of report::button_bitmap
+};
+
+// Everything that differs between cabinets. The pin dispatch table, the IRQ
+// enable mask, the input report and its descriptor are all derived from one
+// of these at compile time, see controller_layout.hpp.
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+struct ControllerLayout {
+    std::array<EncoderLayout, NUM_ENCODERS> encoders;
+    std::array<ButtonLayout, NUM_BUTTONS> buttons;
+};
+
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr uint32_t layout_irq_mask(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout) {
+    uint32_t mask = 0;
+    for (const EncoderLayout &encoder : layout.encoders) {
+        mask |= (1u << encoder.gpio_left) | (1u << encoder.gpio_right);
+    }
+    for (const ButtonLayout &button : layout.buttons) {
+        mask |= 1u << button.gpio;
+    }
+    return mask;
+}
+
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr uint32_t layout_button_mask(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout) {
+    uint32_t mask = 0;
+    for (const ButtonLayout &button : layout.buttons) {
+        mask |= 1u << button.gpio;
+    }
+    return mask;
+}
+
+// Fails on pins that do not exist or are claimed twice, handler indices the
+// dispatch table can not hold, and axes or buttons the report can not carry
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr bool is_valid_layout(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout) {
+    if (NUM_ENCODERS > MAX_PIN_HANDLER_INDEX + 1 || NUM_BUTTONS > LAYOUT_BUTTON_BITMAP_BITS) {
+        return false;
+    }
+    uint32_t claimed = 0;
+    for (const EncoderLayout &encoder : layout.encoders) {
+        if (encoder.gpio_left >= LAYOUT_NUM_GPIOS || encoder.gpio_right >= LAYOUT_NUM_GPIOS
+            || encoder.gpio_left == encoder.gpio_right || encoder.axis >= NUM_CONTROLLER_AXES) {
+            return false;
+        }
+        const uint32_t pins = (1u << encoder.gpio_left) | (1u << encoder.gpio_right);
+        if (claimed & pins) {
+            return false;
+        }
+        claimed |= pins;
+    }
+    for (const ButtonLayout &button : layout.buttons) {
+        if (button.gpio >= LAYOUT_NUM_GPIOS || (claimed & (1u << button.gpio))) {
+            return false;
+        }
+        claimed |= 1u << button.gpio;
+    }
+    return true;
+}
+
+// Bit n set = ControllerAxis n is in the report
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr uint32_t layout_axis_mask(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout) {
+    uint32_t mask = 0;
+    for (const EncoderLayout &encoder : layout.encoders) {
+        mask |= 1u << encoder.axis;
+    }
+    return mask;
+}
+
+constexpr uint axis_mask_count(uint32_t axis_mask) {
+    uint count = 0;
+    for (; axis_mask != 0; axis_mask &= axis_mask - 1) {
+        ++count;
+    }
+    return count;
+}
+
+// Where ControllerAxis axis sits in the report's axes
+constexpr uint axis_mask_slot(uint32_t axis_mask, uint axis) {
+    return axis_mask_count(axis_mask & ((1u << axis) - 1));
+}
+
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr std::array<PinHandler, MAX_GPIO_PINS> make_pin_dispatch_table(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout) {
+    std::array<PinHandler, MAX_GPIO_PINS> table = {};
+    for (uint pin = 0; pin < MAX_GPIO_PINS; ++pin) {
+        table[pin] = PinHandler { NO_HANDLER, 0, 0 };
+    }
+    for (uint index = 0; index < NUM_ENCODERS; ++index) {
+        table[layout.encoders[index].gpio_left] = PinHandler { ROTARY_ENCODER_HANDLER, ROLE_LEFT, (uint8_t)index };
+        table[layout.encoders[index].gpio_right] = PinHandler { ROTARY_ENCODER_HANDLER, ROLE_RIGHT, (uint8_t)index };
+    }
+    for (uint index = 0; index < NUM_BUTTONS; ++index) {
+        table[layout.buttons[index].gpio] = PinHandler { BUTTON_HANDLER, ROLE_BUTTON, (uint8_t)index };
+    }
+    return table;
+}
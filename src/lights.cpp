@@ -0,0 +1,89 @@
+#include <atomic>
+#include <string.h>
+#include "lights.hpp"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+
+#define LIGHT_NO_FRAME -1
+
+// Double buffered. The USB side fills the frame that is not pending, then
+// publishes its index; the wrap interrupt takes whichever index is pending.
+// The interrupt is enabled from the core that runs tinyusb, so a post never
+// lands between the interrupt finding nothing pending and it disarming.
+static LightFrame LIGHT_FRAMES[2];
+static std::atomic<int8_t> PENDING_LIGHT_FRAME { LIGHT_NO_FRAME };
+static uint8_t NEXT_LIGHT_FRAME = 0;  // USB side
+static uint LIGHTS_PACING_SLICE = 0;  // Its wrap interrupt applies frames
+static bool LIGHTS_INITIALIZED = false;
+
+static void __not_in_flash_func(lights_wrap_irq)() {
+    pwm_clear_irq(LIGHTS_PACING_SLICE);
+    const int8_t index = PENDING_LIGHT_FRAME.exchange(LIGHT_NO_FRAME, std::memory_order_acquire);
+    if (index == LIGHT_NO_FRAME) {
+        // Nothing new, stay quiet until the next frame arrives
+        pwm_set_irq_enabled(LIGHTS_PACING_SLICE, false);
+        return;
+    }
+    const LightFrame &frame = LIGHT_FRAMES[index];
+    for (uint channel = 0; channel < LIGHT_CHANNELS; ++channel) {
+        const uint gpio = LIGHT_CHANNEL_GPIOS[channel];
+        if (gpio != LIGHT_UNMAPPED) {
+            // 255 -> 65535, fully on at the default wrap
+            pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), frame.levels[channel] * 257u);
+        }
+    }
+}
+
+void init_lights() {
+    bool pacing_slice_found = false;
+    for (uint channel = 0; channel < LIGHT_CHANNELS; ++channel) {
+        const uint gpio = LIGHT_CHANNEL_GPIOS[channel];
+        if (gpio == LIGHT_UNMAPPED) {
+            continue;
+        }
+        const uint slice_num = pwm_gpio_to_slice_num(gpio);
+        gpio_set_function(gpio, GPIO_FUNC_PWM);
+        pwm_clear_irq(slice_num);
+        pwm_set_irq_enabled(slice_num, false);
+        // Get some sensible defaults for the slice configuration. By default, the
+        // counter is allowed to wrap over its maximum range (0 to 2**16-1)
+        pwm_config config = pwm_get_default_config();
+        // Set divider, reduces counter clock to sysclock/this value
+        pwm_config_set_clkdiv(&config, 1.f);
+        // Load the configuration into our PWM slice, and set it running.
+        pwm_init(slice_num, &config, true);
+        pwm_set_chan_level(slice_num, pwm_gpio_to_channel(gpio), 0);
+        if (!pacing_slice_found) {
+            LIGHTS_PACING_SLICE = slice_num;
+            pacing_slice_found = true;
+        }
+    }
+    PENDING_LIGHT_FRAME.store(LIGHT_NO_FRAME, std::memory_order_relaxed);
+    NEXT_LIGHT_FRAME = 0;
+    LIGHTS_INITIALIZED = pacing_slice_found;
+    if (pacing_slice_found) {
+        irq_set_exclusive_handler(PWM_IRQ_WRAP, lights_wrap_irq);
+        irq_set_enabled(PWM_IRQ_WRAP, true);
+    }
+}
+
+// Copies up to LIGHT_CHANNELS levels, missing channels read as off. Returns
+// false if the lights are not running.
+bool post_light_frame(const uint8_t* levels, uint16_t len) {
+    if (!LIGHTS_INITIALIZED) [[unlikely]] {
+        return false;
+    }
+    if (len > LIGHT_CHANNELS) {
+        len = LIGHT_CHANNELS;
+    }
+    // A frame still pending is superseded. Its buffer is not the one being
+    // filled, and the interrupt copies a frame far faster than the host can
+    // send two, so the interrupt never reads a buffer mid fill.
+    LightFrame &frame = LIGHT_FRAMES[NEXT_LIGHT_FRAME];
+    memcpy(frame.levels, levels, len);
+    memset(frame.levels + len, 0, LIGHT_CHANNELS - len);
+    PENDING_LIGHT_FRAME.store(NEXT_LIGHT_FRAME, std::memory_order_release);
+    NEXT_LIGHT_FRAME ^= 1;
+    pwm_set_irq_enabled(LIGHTS_PACING_SLICE, true);
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+#define LIGHTS_REPORT_ID 2  // Must match desc_hid_report
+#define LIGHT_CHANNELS 25  // 16 button lights + 3x RGB, as in GAMECON_REPORT_DESC_LIGHTS
+#define LIGHT_UNMAPPED 0xFF
+#define NUM_PWM_OUTPUTS 16  // 8 slices x 2 channels, shared by GPIO n and n + 16
+
+// GPIO driven by each channel of the LIGHTS report, LIGHT_UNMAPPED for none.
+// GPIO n drives PWM slice (n >> 1) & 7, channel n & 1, so at most
+// NUM_PWM_OUTPUTS channels can have a pin and no two may share an output.
+constexpr uint8_t LIGHT_CHANNEL_GPIOS[LIGHT_CHANNELS] = {
+    PICO_DEFAULT_LED_PIN,  // Button 0
+    LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED,
+    LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED,
+    LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED,
+    2, 3, 4,  // RGB 0
+    LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED,  // RGB 1
+    LIGHT_UNMAPPED, LIGHT_UNMAPPED, LIGHT_UNMAPPED,  // RGB 2
+};
+
+constexpr bool light_channels_share_no_pwm_output() {
+    for (uint a = 0; a < LIGHT_CHANNELS; ++a) {
+        for (uint b = a + 1; b < LIGHT_CHANNELS; ++b) {
+            if (LIGHT_CHANNEL_GPIOS[a] != LIGHT_UNMAPPED && LIGHT_CHANNEL_GPIOS[b] != LIGHT_UNMAPPED
+                && (LIGHT_CHANNEL_GPIOS[a] & (NUM_PWM_OUTPUTS - 1)) == (LIGHT_CHANNEL_GPIOS[b] & (NUM_PWM_OUTPUTS - 1))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(light_channels_share_no_pwm_output(), "Two light channels drive the same PWM output");
+
+// One level per channel, 0 = off, 255 = fully on
+struct LightFrame {
+    uint8_t levels[LIGHT_CHANNELS];
+};
+
+// The USB side posts frames whenever they arrive; they reach the PWM compare
+// registers from the PWM wrap interrupt, so posting is a 25 byte copy and
+// never waits on the hardware. Only the newest frame posted before a wrap
+// is shown.
+void init_lights();
+bool post_light_frame(const uint8_t* levels, uint16_t len);
@@ -1,19 +1,38 @@
 #include <optional>
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "boot_timeline.hpp"
 #include "button.hpp"
+#include "dispatch.hpp"
 #include "event.hpp"
+#include "flight_recorder.hpp"
+#include "instrumentation.hpp"
+#include "report_mailbox.hpp"
+#include "report_scheduler.hpp"
 #include "rotary_encoder.hpp"
+#include "scanner.hpp"
+#include "tuning.hpp"
 
 #ifndef DEBUG_MODE
 #include "bsp/board.h"
-#include "hardware/pwm.h"
+#include "lights.hpp"
 #include "tusb.h"
 #endif
 
-#define ROTARY_0_GPIO_0 0
-#define ROTARY_0_GPIO_1 1
-#define BUTTON_0_GPIO  16
+#ifdef DUAL_CORE
+#include "pico/multicore.h"
+#endif
+
+#ifdef IDLE_SLEEP
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#include "idle_sleep.hpp"
+#endif
+
+static ReportScheduler REPORT_SCHEDULER;
+static Joystick* INPUT_JOYSTICK = nullptr;  // Belongs to whichever core handles input
 
 void pico_led_init() {
     gpio_init(PICO_DEFAULT_LED_PIN);
@@ -24,84 +43,264 @@ void pico_set_led(bool on) {
     gpio_put(PICO_DEFAULT_LED_PIN, on);
 }
 
+#ifdef SDK_GPIO_IRQ
 void gpio_callback(uint gpio, uint32_t event_mask) {
     record_event(gpio, event_mask);
     // irq is automatically acknowledged
+    instrument_isr_exit(1);
+}
+
+#ifdef INSTRUMENTATION
+// Runs ahead of the SDK's GPIO handler, so the cycle count includes the
+// SDK walking the status registers up to the last callback
+static void gpio_irq_entry() {
+    instrument_isr_enter();
+}
+#endif
+#endif
+
+// Sets up every handler in CONTROLLER_LAYOUT and routes the GPIO interrupt,
+// or the scan timer with SCAN_INPUTS, to the calling core. Takes a few us,
+// and the handlers hold the pins' current state when it returns.
+static Joystick* init_input_handling() {
+    init_joystick();
+    init_input_handlers();
+    Joystick* stick = get_joystick();
+
+    // pico_set_led(true);
+
+    #ifdef SCAN_INPUTS
+    init_input_scan(capture_input_state());
+    #else
+    init_isr_cycle_counter();
+    #ifdef SDK_GPIO_IRQ
+    gpio_set_irq_callback(&gpio_callback);
+    #ifdef INSTRUMENTATION
+    irq_add_shared_handler(IO_IRQ_BANK0, gpio_irq_entry, PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
+    #endif
+    #else
+    irq_set_exclusive_handler(IO_IRQ_BANK0, input_irq_handler);
+    #endif
+    enable_input_irq();
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    capture_input_state();
+    #endif
+    INPUT_JOYSTICK = stick;
+    record_boot_phase(BOOT_PHASE_INPUTS_READY);
+    return stick;
+}
+
+// Runs every queued event through its pin handler
+static void drain_events(Event* events) {
+    uint num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    if (num_events > 0) {
+        instrument_events_picked_up();
+    }
+    while (num_events > 0) {
+        for (uint i = 0; i < num_events; ++i) {
+            dispatch_event(events[i]);
+        }
+        instrument_events_decoded(events, num_events);
+        num_events = pop_events(events, EVENT_DRAIN_BATCH_LENGTH);
+    }
+    resync_dropped_inputs();
+}
+
+#ifndef DEBUG_MODE
+// Copies whatever changed since the last call into r, returns false if nothing did
+static bool apply_inputs_to_report(Joystick* stick, report &r) {
+    bool changed = false;
+    if (stick->has_changes()) {
+        stick->apply_to_report(r);
+        changed = true;
+    }
+    if (buttons_have_changes()) {
+        apply_buttons_to_report(r);
+        changed = true;
+    }
+    return changed;
+}
+
+#ifdef DUAL_CORE
+static ReportMailbox REPORT_MAILBOX;
+static uint32_t REPORT_MAILBOX_SEQUENCE = 0;  // Core 0
+#endif
+
+// Brings the staged report up to date with all input handled so far
+static void stage_inputs() {
+    #ifdef DUAL_CORE
+    LatencyStamp stamp;
+    if (REPORT_MAILBOX.read_if_newer(REPORT_SCHEDULER.get_staged(), stamp, REPORT_MAILBOX_SEQUENCE)) {
+        stage_latency_stamp(stamp);
+    }
+    #else
+    // Turn accumulated encoder ticks into axis movement once per report
+    emit_rotary_encoder_rotations();
+    apply_inputs_to_report(INPUT_JOYSTICK, REPORT_SCHEDULER.get_staged());
+    #endif
+}
+
+static void send_staged_report() {
+    const wire_report* next = REPORT_SCHEDULER.begin_send();
+    if (next == nullptr) {
+        instrument_report_unchanged();
+    }
+    else if (!tud_hid_n_report(0x00, GAMEPAD_REPORT_ID, next, GAMEPAD_REPORT_LENGTH)) {
+        REPORT_SCHEDULER.cancel_send();
+        instrument_report_refused();
+    }
+    else {
+        instrument_report_sent(time_us_32());
+    }
+}
+
+#ifdef IDLE_SLEEP
+// Lets an interrupt end a WFE even while PRIMASK holds it off
+static void enable_wake_on_pending() {
+    scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
 }
 
+// The idle checks in idle_sleep.cpp, bound to this loop's state and tinyusb
+#ifdef DUAL_CORE
+static bool core0_has_work() {
+    return usb_has_work(REPORT_SCHEDULER, tud_task_event_ready(), tud_hid_ready(), REPORT_MAILBOX.has_newer(REPORT_MAILBOX_SEQUENCE));
+}
+
+static bool core1_has_work() {
+    return input_core_has_work(INPUT_JOYSTICK);
+}
+#else
+static bool loop_has_work() {
+    return main_loop_has_work(INPUT_JOYSTICK, REPORT_SCHEDULER, tud_task_event_ready(), tud_hid_ready());
+}
+#endif
+#endif
+#endif
+
+#ifdef DUAL_CORE
+// Core 1 owns the GPIO interrupt, the event queue and every handler, and
+// publishes a report snapshot whenever one changes. It never touches tinyusb.
+void core1_main() {
+    Joystick* stick = init_input_handling();
+    report r = {};
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    #ifdef IDLE_SLEEP
+    enable_wake_on_pending();
+    #endif
+
+    while (true) {
+        apply_pending_tuning();
+        drain_events(events);
+        settle_buttons(time_us_32());
+        emit_rotary_encoder_rotations();
+        const LatencyStamp stamp = take_decoded_latency_stamp();
+        if (apply_inputs_to_report(stick, r)) {
+            REPORT_MAILBOX.publish(r, stamp);
+            #ifdef IDLE_SLEEP
+            __sev();  // Core 0 may be asleep
+            #endif
+        }
+        #ifdef IDLE_SLEEP
+        if (sleep_unless(core1_has_work)) {
+            instrument_idle_sleep();
+        }
+        #endif
+    }
+}
+#endif
+
+// Nothing here waits. Enumeration only moves on while the loop runs
+// tud_task(), and the input handlers hold the pins' state within a few us of
+// start, long before the host could ask for a report.
 int main() {
+    record_boot_phase(BOOT_PHASE_MAIN);
 
     #ifndef DEBUG_MODE
     board_init();
     tusb_init();
+    record_boot_phase(BOOT_PHASE_USB_STARTED);
 
-    gpio_set_function(PICO_DEFAULT_LED_PIN, GPIO_FUNC_PWM);
-    uint slice_num = pwm_gpio_to_slice_num(PICO_DEFAULT_LED_PIN);
-
-    pwm_clear_irq(slice_num);
-    pwm_set_irq_enabled(slice_num, false);
-    // Get some sensible defaults for the slice configuration. By default, the
-    // counter is allowed to wrap over its maximum range (0 to 2**16-1)
-    pwm_config config = pwm_get_default_config();
-    // Set divider, reduces counter clock to sysclock/this value
-    pwm_config_set_clkdiv(&config, 1.f);
-    // Load the configuration into our PWM slice, and set it running.
-    pwm_init(slice_num, &config, true);
+    init_lights();
     #endif
 
     stdio_init_all();
 
     // pico_led_init();
 
-    sleep_ms(3000);  // LOAD BEARING!!
-
-    printf("Ready!\n");
-    
-    init_rotary_encoder_handling();
-    init_button_handling();
-
-    Joystick* stick = Joystick::create_and_register().value();
-
-    if (!RotaryEncoder::create_and_register(ROTARY_0_GPIO_0, ROTARY_0_GPIO_1, stick)) {
-        panic("Failed to create Rotary Encoder handler!\n");
-    }
+    #ifdef DUAL_CORE
+    multicore_launch_core1(core1_main);
+    #ifdef IDLE_SLEEP
+    enable_wake_on_pending();
+    #endif
 
-    if (!Button::create_and_register(BUTTON_0_GPIO)) {
-        panic("Failed to create Button handler!\n");
+    // Core 0 only runs tinyusb and stages the newest snapshot
+    while (true) {
+        tud_task(); // tinyusb task
+        stage_inputs();
+        if (!REPORT_SCHEDULER.is_busy() && tud_hid_ready()) {
+            send_staged_report();
+        }
+        else {
+            instrument_endpoint_busy();
+        }
+        #ifdef IDLE_SLEEP
+        sleep_unless(core0_has_work);
+        #endif
     }
+    #else
+    Joystick* stick = init_input_handling();
+    printf("Ready!\n");
 
-    // pico_set_led(true);
-
-    gpio_set_irq_callback(&gpio_callback);
-    enable_rotary_encoder_irq();
-    enable_button_irq();
-    irq_set_enabled(IO_IRQ_BANK0, true);
-
-    report r = report { 0, 0, 0, 0, 0 };
+    #ifdef DEBUG_MODE
+    report r = {};
+    #endif
+    Event events[EVENT_DRAIN_BATCH_LENGTH];
+    #ifdef IDLE_SLEEP
+    enable_wake_on_pending();
+    #endif
 
     while (true) {
 
-        std::optional<Event> maybe_event = pop_event();
-        while (maybe_event.has_value()) {
-            handle_rotary_encoder_event(maybe_event.value());
-            handle_button_event(maybe_event.value());
-            maybe_event = pop_event();
-        }
         #ifndef DEBUG_MODE
-        if (stick->has_changes()) {
-            stick->apply_to_report(r);
-            if (tud_hid_ready()) {
-                tud_hid_n_report(0x00, 0x01, &r, sizeof(r));
-            }
+        apply_pending_tuning();
+        #endif
+        drain_events(events);
+        settle_buttons(time_us_32());
+        #ifndef DEBUG_MODE
+        stage_latency_stamp(take_decoded_latency_stamp());
+        if (!REPORT_SCHEDULER.is_busy() && tud_hid_ready()) {
+            stage_inputs();
+            send_staged_report();
+        }
+        else {
+            instrument_endpoint_busy();
         }
         tud_task(); // tinyusb task
+        #ifdef IDLE_SLEEP
+        if (sleep_unless(loop_has_work)) {
+            instrument_idle_sleep();
+        }
+        #endif
         #else
+        emit_rotary_encoder_rotations();
         if (stick->has_changes()) {
             stick->apply_to_report(r);
-            printf("%d\n", r.joystick_rotation_x);
+            for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+                printf(slot + 1 < CONTROLLER_NUM_AXES ? "%lu " : "%lu\n", (unsigned long)r.axes[slot]);
+            }
         }
+        if (buttons_have_changes()) {
+            apply_buttons_to_report(r);
+            printf("%04x\n", r.button_bitmap);
+        }
+        #ifdef FLIGHT_RECORDER
+        if (getchar_timeout_us(0) == 'd') {
+            print_flight_recorder();
+        }
+        #endif
         #endif
     }
+    #endif
 
     return 0;
 }
@@ -114,11 +313,14 @@ int main() {
 // Invoked when device is mounted
 void tud_mount_cb(void)
 {
+    REPORT_SCHEDULER.reset();
+    record_boot_phase(BOOT_PHASE_MOUNTED);
 }
 
 // Invoked when device is unmounted
 void tud_umount_cb(void)
 {
+    REPORT_SCHEDULER.reset();
 }
 
 // Invoked when usb bus is suspended
@@ -138,17 +340,43 @@ void tud_resume_cb(void)
 // USB HID
 //--------------------------------------------------------------------+
 
+// Invoked when a report was sent to the host successfully
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+{
+    (void)instance;
+    (void)report;
+    (void)len;
+    REPORT_SCHEDULER.complete_send();
+    instrument_report_complete(time_us_32());
+    record_boot_phase(BOOT_PHASE_FIRST_REPORT);
+}
+
 // Invoked when received GET_REPORT control request
 // Application must fill buffer report's content and return its length.
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
 {
-    // TODO not Implemented
-    (void)report_id;
-    (void)report_type;
-    (void)buffer;
-    (void)reqlen;
-
+    (void)instance;
+    if (report_type == HID_REPORT_TYPE_INPUT && report_id == GAMEPAD_REPORT_ID) {
+        // Whatever the inputs read right now, even if nothing moved since mount
+        stage_inputs();
+        const wire_report staged = REPORT_SCHEDULER.peek();
+        uint16_t len = GAMEPAD_REPORT_LENGTH < reqlen ? GAMEPAD_REPORT_LENGTH : reqlen;
+        memcpy(buffer, &staged, len);
+        return len;
+    }
+    if (report_type == HID_REPORT_TYPE_FEATURE) {
+        if (report_id == TUNING_REPORT_ID) {
+            return get_tuning_report(buffer, reqlen);
+        }
+        if (report_id == FLIGHT_RECORDER_REPORT_ID) {
+            return get_flight_recorder_report(buffer, reqlen);
+        }
+        if (report_id == BOOT_TIMELINE_REPORT_ID) {
+            return get_boot_timeline_report(buffer, reqlen);
+        }
+        return get_instrumentation_report(report_id, buffer, reqlen);
+    }
     return 0;
 }
 
@@ -156,19 +384,25 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
-    return;
-    /*
-    if (report_id == 2 && report_type == HID_REPORT_TYPE_OUTPUT && buffer[0] == 2 && bufsize >= sizeof(light_data)) //light data
-    {
-        size_t i = 0;
-        for (i; i < sizeof(light_data); i++)
-        {
-            light_data.raw[i] = buffer[i + 1];
-        }
+    (void)instance;
+    if (report_id == 0 && bufsize > 0) {
+        // Interrupt OUT endpoint data, which still starts with its report ID
+        report_id = buffer[0];
+        report_type = HID_REPORT_TYPE_OUTPUT;
+        ++buffer;
+        --bufsize;
+    }
+    if (report_type == HID_REPORT_TYPE_OUTPUT && report_id == LIGHTS_REPORT_ID) {
+        post_light_frame(buffer, bufsize);
+    }
+    else if (report_type == HID_REPORT_TYPE_FEATURE && report_id == TUNING_REPORT_ID) {
+        request_tuning(buffer, bufsize);
+        #if defined(IDLE_SLEEP) && defined(DUAL_CORE)
+        __sev();  // The input core may be asleep
+        #endif
+    }
+    else if (report_type == HID_REPORT_TYPE_FEATURE && report_id == FLIGHT_RECORDER_REPORT_ID) {
+        command_flight_recorder(buffer, bufsize);
     }
-    */
-
-    // echo back anything we received from host
-    tud_hid_report(0, buffer, bufsize);
 }
 #endif
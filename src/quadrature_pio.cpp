@@ -0,0 +1,54 @@
+#include "quadrature_pio.hpp"
+
+static const pio_program_t QUADRATURE_PIO_PROGRAM = {
+    QUADRATURE_PIO_INSTRUCTIONS,
+    QUADRATURE_PIO_LENGTH,
+    0,
+};
+
+// Once, before any encoder starts
+void load_quadrature_pio_program() {
+    if (!pio_can_add_program(pio0, &QUADRATURE_PIO_PROGRAM)) {
+        panic("No room for the quadrature program on pio0!\n");
+    }
+    pio_add_program(pio0, &QUADRATURE_PIO_PROGRAM);
+}
+
+// Claims a state machine and starts it counting from 0 on gpio_left and the
+// pin after it. Returns the state machine.
+uint start_quadrature_pio(uint gpio_left) {
+    const uint sm = (uint)pio_claim_unused_sm(pio0, true);
+    pio_gpio_init(pio0, gpio_left);
+    pio_gpio_init(pio0, gpio_left + 1);
+    pio_sm_set_consecutive_pindirs(pio0, sm, gpio_left, 2, false);
+
+    pio_sm_config config = pio_get_default_sm_config();
+    sm_config_set_wrap(&config, QUADRATURE_PIO_WRAP_TARGET, QUADRATURE_PIO_WRAP);
+    sm_config_set_in_pins(&config, gpio_left);
+    // in shifts the new levels in at the bottom, out takes the previous
+    // levels off the bottom
+    sm_config_set_in_shift(&config, false, false, 32);
+    sm_config_set_out_shift(&config, true, false, 32);
+    sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv(&config, QUADRATURE_PIO_CLKDIV);
+    pio_sm_init(pio0, sm, 0, &config);
+    // The previous levels start out as the pins read now, through the
+    // program's own in and mov, so the first pass compares against where the
+    // knob really rests instead of BOTH_DOWN. Starting at 0 then jumps
+    // straight to update.
+    pio_sm_exec(pio0, sm, QUADRATURE_PIO_INSTRUCTIONS[QUADRATURE_PIO_SAMPLE]);
+    pio_sm_exec(pio0, sm, QUADRATURE_PIO_INSTRUCTIONS[QUADRATURE_PIO_KEEP_LEVELS]);
+    pio_sm_set_enabled(pio0, sm, true);
+    return sm;
+}
+
+// The newest count. The FIFO only keeps the oldest pushes once it is full, so
+// it is drained and then one more fresh push is waited for, which takes a
+// pass of the program, well under 10 us.
+int32_t read_quadrature_pio_count(uint sm) {
+    uint32_t count = 0;
+    for (uint n = pio_sm_get_rx_fifo_level(pio0, sm) + 1; n > 0; --n) {
+        count = pio_sm_get_blocking(pio0, sm);
+    }
+    return (int32_t)count;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "layout.hpp"
+
+// Quadrature decoding in a PIO state machine, one per encoder. The program
+// loops on sampling both pins, jumps through a table indexed by
+// (previous levels << 2) | new levels, and keeps a signed count in Y that it
+// pushes to the RX FIFO on every pass. The CPU does nothing per edge and
+// reads the newest count whenever it likes.
+//
+// Pins read as RotaryEncoderState does: the left pin is bit 0 and the right
+// pin, which must be the next GPIO up, bit 1. Turning right counts up.
+// Transitions where both pins changed at once are dropped, and the next
+// sample picks up from the new levels.
+//
+// The program jumps to its own table with mov pc, so it must load at 0.
+
+#define QUADRATURE_PIO_LENGTH 24
+#define QUADRATURE_PIO_WRAP_TARGET 15
+#define QUADRATURE_PIO_WRAP 23
+#define QUADRATURE_PIO_SAMPLE 18  // in pins, 2
+#define QUADRATURE_PIO_KEEP_LEVELS 19  // mov osr, isr
+#define QUADRATURE_PIO_CLKDIV 125.f  // 1 MHz at 125 MHz, ~150k samples/s: any knob, with margin
+#define QUADRATURE_PIO_MAX_ENCODERS 4  // State machines on pio0
+
+// As pioasm would assemble it, addresses in the comments
+constexpr uint16_t QUADRATURE_PIO_INSTRUCTIONS[QUADRATURE_PIO_LENGTH] = {
+    // Jump table: previous BOTH_DOWN
+    0x000f,  //  0: jmp update          -> BOTH_DOWN
+    0x000e,  //  1: jmp decrement       -> LEFT_UP
+    0x0015,  //  2: jmp increment       -> RIGHT_UP
+    0x000f,  //  3: jmp update          -> BOTH_UP, skipped a step
+    // Previous LEFT_UP
+    0x0015,  //  4: jmp increment       -> BOTH_DOWN
+    0x000f,  //  5: jmp update          -> LEFT_UP
+    0x000f,  //  6: jmp update          -> RIGHT_UP, skipped a step
+    0x000e,  //  7: jmp decrement       -> BOTH_UP
+    // Previous RIGHT_UP
+    0x000e,  //  8: jmp decrement       -> BOTH_DOWN
+    0x000f,  //  9: jmp update          -> LEFT_UP, skipped a step
+    0x000f,  // 10: jmp update          -> RIGHT_UP
+    0x0015,  // 11: jmp increment       -> BOTH_UP
+    // Previous BOTH_UP. The last two entries are the code they jump to.
+    0x000f,  // 12: jmp update          -> BOTH_DOWN, skipped a step
+    0x0015,  // 13: jmp increment       -> LEFT_UP
+    0x008f,  // 14: decrement: jmp y--, update   -> RIGHT_UP
+    // .wrap_target
+    0xa0c2,  // 15: update: mov isr, y           -> BOTH_UP
+    0x8000,  // 16: push noblock
+    0x60c2,  // 17: out isr, 2          Previous levels from the last pass
+    0x4002,  // 18: in pins, 2          Shifted up under the new ones
+    0xa0e6,  // 19: mov osr, isr        Kept for the next pass
+    0xa0a6,  // 20: mov pc, isr         Into the table
+    0xa04a,  // 21: increment: mov y, ~y
+    0x0097,  // 22: jmp y--, 23         y + 1 as ~(~y - 1)
+    0xa04a,  // 23: mov y, ~y
+    // .wrap
+};
+
+// Every encoder's right pin is the one after its left pin, and there is a
+// state machine for each
+template <size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr bool is_quadrature_pio_layout(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout) {
+    if (NUM_ENCODERS > QUADRATURE_PIO_MAX_ENCODERS) {
+        return false;
+    }
+    for (const EncoderLayout &encoder : layout.encoders) {
+        if (encoder.gpio_right != encoder.gpio_left + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void load_quadrature_pio_program();
+uint start_quadrature_pio(uint gpio_left);
+int32_t read_quadrature_pio_count(uint sm);
@@ -1,9 +1,54 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "controller_layout.hpp"
 
-struct report {
+#define GAMEPAD_REPORT_ID 1  // Must match desc_hid_report
+
+// HIGH_RESOLUTION_AXES widens every axis on the bus to 16 bits. The joystick
+// position is 8.8 fixed point, so the extra byte is the fraction an 8-bit
+// axis drops.
+//
+// DIAL_REPORT sends each axis as the signed distance moved since the last
+// report the host confirmed, instead of a position that wraps. The report
+// the handlers fill then holds 32-bit running positions, and the
+// ReportScheduler turns them into deltas when it sends.
+#ifdef HIGH_RESOLUTION_AXES
+#ifdef DIAL_REPORT
+typedef int16_t WireAxisValue;
+#else
+typedef uint16_t WireAxisValue;
+#endif
+#else
+#ifdef DIAL_REPORT
+typedef int8_t WireAxisValue;
+#else
+typedef uint8_t WireAxisValue;
+#endif
+#endif
+
+#ifdef DIAL_REPORT
+typedef uint32_t AxisValue;  // Wraps, compare by signed difference only
+#else
+typedef WireAxisValue AxisValue;
+#endif
+
+#define REPORT_AXIS_BITS (8 * sizeof(WireAxisValue))
+#define REPORT_AXIS_SHIFT (16 - REPORT_AXIS_BITS)  // Bits of the joystick's 8.8 position below one axis step
+
+// The input report for a layout: the button bitmap, then one axis value per
+// bound axis in ControllerAxis order
+template <typename AXIS_VALUE, uint NUM_AXES>
+struct GamepadReport {
     uint16_t button_bitmap;
-    uint8_t joystick_z;
-    uint8_t joystick_rotation_x;
-    uint8_t joystick_rotation_y;
-    uint8_t joystick_rotation_z;
+    AXIS_VALUE axes[NUM_AXES];
 };
+
+typedef GamepadReport<AxisValue, CONTROLLER_NUM_AXES> report;  // As the handlers fill it in
+typedef GamepadReport<WireAxisValue, CONTROLLER_NUM_AXES> wire_report;  // As it goes on the bus
+
+// What goes on the bus. sizeof(wire_report) can be larger by trailing padding.
+constexpr uint16_t GAMEPAD_REPORT_LENGTH = sizeof(uint16_t) + CONTROLLER_NUM_AXES * sizeof(WireAxisValue);
+
+static_assert(offsetof(wire_report, axes) == sizeof(uint16_t), "The axes must follow the button bitmap without padding");
+static_assert(sizeof(wire_report) >= GAMEPAD_REPORT_LENGTH, "wire_report must hold its own bytes");
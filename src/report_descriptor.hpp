@@ -0,0 +1,132 @@
+#pragma once
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include "layout.hpp"
+#include "report.hpp"
+
+// Short item prefixes, tag and type only. The size code goes in the low bits.
+enum DescriptorItem : uint8_t {
+    DESCRIPTOR_ITEM_INPUT = 0x80,
+    DESCRIPTOR_ITEM_COLLECTION = 0xA0,
+    DESCRIPTOR_ITEM_END_COLLECTION = 0xC0,
+    DESCRIPTOR_ITEM_USAGE_PAGE = 0x04,
+    DESCRIPTOR_ITEM_LOGICAL_MIN = 0x14,
+    DESCRIPTOR_ITEM_LOGICAL_MAX = 0x24,
+    DESCRIPTOR_ITEM_REPORT_SIZE = 0x74,
+    DESCRIPTOR_ITEM_REPORT_ID = 0x84,
+    DESCRIPTOR_ITEM_REPORT_COUNT = 0x94,
+    DESCRIPTOR_ITEM_USAGE = 0x08,
+    DESCRIPTOR_ITEM_USAGE_MIN = 0x18,
+    DESCRIPTOR_ITEM_USAGE_MAX = 0x28,
+};
+
+#define DESCRIPTOR_USAGE_PAGE_DESKTOP 0x01
+#define DESCRIPTOR_USAGE_PAGE_BUTTON 0x09
+#define DESCRIPTOR_USAGE_GAMEPAD 0x05
+#define DESCRIPTOR_COLLECTION_APPLICATION 0x01
+#define DESCRIPTOR_INPUT_DATA_VARIABLE_ABSOLUTE 0x02
+#define DESCRIPTOR_INPUT_CONSTANT 0x03
+#define DESCRIPTOR_INPUT_DATA_VARIABLE_RELATIVE 0x06
+
+// Descriptor bytes built up in a constexpr function. Items past the end of
+// bytes are only counted, so a run with N = 0 measures the descriptor.
+template <size_t N>
+struct DescriptorBytes {
+    std::array<uint8_t, N> bytes;
+    size_t length;
+
+    constexpr void put(uint8_t byte) {
+        if (length < N) {
+            bytes[length] = byte;
+        }
+        ++length;
+    }
+
+    // size is 0, 1, 2 or 4 bytes of little endian data
+    constexpr void item(uint8_t prefix, uint32_t value, uint size) {
+        put((uint8_t)(prefix | (size == 4 ? 3 : size)));
+        for (uint i = 0; i < size; ++i) {
+            put((uint8_t)(value >> (8 * i)));
+        }
+    }
+};
+
+// The gamepad collection for a layout, matching GamepadReport field for
+// field: the buttons padded out to the 16-bit bitmap, then the bound axes,
+// axis_bits (8 or 16) wide each. Relative axes are signed deltas with a
+// symmetric range.
+template <size_t N, size_t NUM_ENCODERS, size_t NUM_BUTTONS>
+constexpr DescriptorBytes<N> make_gamepad_report_descriptor(const ControllerLayout<NUM_ENCODERS, NUM_BUTTONS> &layout, uint8_t report_id, uint axis_bits, bool relative) {
+    DescriptorBytes<N> d = { {}, 0 };
+    d.item(DESCRIPTOR_ITEM_USAGE_PAGE, DESCRIPTOR_USAGE_PAGE_DESKTOP, 1);
+    d.item(DESCRIPTOR_ITEM_USAGE, DESCRIPTOR_USAGE_GAMEPAD, 1);
+    d.item(DESCRIPTOR_ITEM_COLLECTION, DESCRIPTOR_COLLECTION_APPLICATION, 1);
+    d.item(DESCRIPTOR_ITEM_REPORT_ID, report_id, 1);
+    if (NUM_BUTTONS > 0) {
+        d.item(DESCRIPTOR_ITEM_USAGE_PAGE, DESCRIPTOR_USAGE_PAGE_BUTTON, 1);
+        d.item(DESCRIPTOR_ITEM_USAGE_MIN, 1, 1);
+        d.item(DESCRIPTOR_ITEM_USAGE_MAX, NUM_BUTTONS, 1);
+        d.item(DESCRIPTOR_ITEM_LOGICAL_MIN, 0, 1);
+        d.item(DESCRIPTOR_ITEM_LOGICAL_MAX, 1, 1);
+        d.item(DESCRIPTOR_ITEM_REPORT_COUNT, NUM_BUTTONS, 1);
+        d.item(DESCRIPTOR_ITEM_REPORT_SIZE, 1, 1);
+        d.item(DESCRIPTOR_ITEM_INPUT, DESCRIPTOR_INPUT_DATA_VARIABLE_ABSOLUTE, 1);
+    }
+    if (NUM_BUTTONS < LAYOUT_BUTTON_BITMAP_BITS) {
+        d.item(DESCRIPTOR_ITEM_REPORT_COUNT, LAYOUT_BUTTON_BITMAP_BITS - NUM_BUTTONS, 1);
+        d.item(DESCRIPTOR_ITEM_REPORT_SIZE, 1, 1);
+        d.item(DESCRIPTOR_ITEM_INPUT, DESCRIPTOR_INPUT_CONSTANT, 1);
+    }
+    const uint32_t axis_mask = layout_axis_mask(layout);
+    d.item(DESCRIPTOR_ITEM_USAGE_PAGE, DESCRIPTOR_USAGE_PAGE_DESKTOP, 1);
+    if (relative) {
+        const uint32_t limit = (1u << (axis_bits - 1)) - 1;
+        d.item(DESCRIPTOR_ITEM_LOGICAL_MIN, (uint32_t)-(int32_t)limit, axis_bits / 8);
+        d.item(DESCRIPTOR_ITEM_LOGICAL_MAX, limit, axis_bits / 8);
+    }
+    else {
+        d.item(DESCRIPTOR_ITEM_LOGICAL_MIN, 0, 1);
+        // Logical extents are signed, so the top of an unsigned range needs a
+        // byte more than the axis
+        if (axis_bits == 16) {
+            d.item(DESCRIPTOR_ITEM_LOGICAL_MAX, 0x0000ffff, 4);
+        }
+        else {
+            d.item(DESCRIPTOR_ITEM_LOGICAL_MAX, 0x00ff, 2);
+        }
+    }
+    for (uint axis = 0; axis < NUM_CONTROLLER_AXES; ++axis) {
+        if (axis_mask & (1u << axis)) {
+            d.item(DESCRIPTOR_ITEM_USAGE, CONTROLLER_AXIS_USAGES[axis], 1);
+        }
+    }
+    d.item(DESCRIPTOR_ITEM_REPORT_COUNT, axis_mask_count(axis_mask), 1);
+    d.item(DESCRIPTOR_ITEM_REPORT_SIZE, axis_bits, 1);
+    d.item(DESCRIPTOR_ITEM_INPUT, relative ? DESCRIPTOR_INPUT_DATA_VARIABLE_RELATIVE : DESCRIPTOR_INPUT_DATA_VARIABLE_ABSOLUTE, 1);
+    d.item(DESCRIPTOR_ITEM_END_COLLECTION, 0, 0);
+    return d;
+}
+
+#ifdef DIAL_REPORT
+#define GAMEPAD_REPORT_RELATIVE_AXES true
+#else
+#define GAMEPAD_REPORT_RELATIVE_AXES false
+#endif
+
+constexpr size_t GAMEPAD_REPORT_DESCRIPTOR_LENGTH = make_gamepad_report_descriptor<0>(CONTROLLER_LAYOUT, GAMEPAD_REPORT_ID, REPORT_AXIS_BITS, GAMEPAD_REPORT_RELATIVE_AXES).length;
+constexpr std::array<uint8_t, GAMEPAD_REPORT_DESCRIPTOR_LENGTH> GAMEPAD_REPORT_DESCRIPTOR =
+    make_gamepad_report_descriptor<GAMEPAD_REPORT_DESCRIPTOR_LENGTH>(CONTROLLER_LAYOUT, GAMEPAD_REPORT_ID, REPORT_AXIS_BITS, GAMEPAD_REPORT_RELATIVE_AXES).bytes;
+
+// Appends the rest of desc_hid_report to the generated gamepad collection
+template <size_t N, size_t M>
+constexpr std::array<uint8_t, N + M> join_report_descriptors(const std::array<uint8_t, N> &first, const uint8_t (&second)[M]) {
+    std::array<uint8_t, N + M> joined = {};
+    for (size_t i = 0; i < N; ++i) {
+        joined[i] = first[i];
+    }
+    for (size_t i = 0; i < M; ++i) {
+        joined[N + i] = second[i];
+    }
+    return joined;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "instrumentation.hpp"
+#include "report.hpp"
+
+// Hands finished reports from the input core to the USB core. A seqlock:
+// the single writer makes the sequence odd while it copies and even again
+// once done, and a reader retries whenever it saw an odd sequence or the
+// sequence moved under it. The writer never waits on the reader, so a slow
+// tud_task() can not hold up decoding, and a reader only ever spins for the
+// length of one report copy.
+//
+// With INSTRUMENTATION each snapshot also carries the LatencyStamp of the
+// input folded into it. A snapshot the reader never saw hands its stamp on
+// to the next one, so a superseded report does not hide its input's wait.
+// A read that lands mid publish can get a stamp counted twice, which only
+// ever errs towards reporting more latency.
+class ReportMailbox {
+private:
+    std::atomic<uint32_t> sequence;  // Even = stable, 0 = nothing published yet
+    report value;
+    LatencyStamp stamp;
+    #ifdef INSTRUMENTATION
+    std::atomic<uint32_t> consumed;  // Last sequence the reader copied
+    #endif
+
+public:
+    ReportMailbox():
+        sequence(0),
+        value {},
+        stamp {}
+        #ifdef INSTRUMENTATION
+        , consumed(0)
+        #endif
+    { }
+
+    // Writer side
+    void publish(const report &next, const LatencyStamp &next_stamp) {
+        const uint32_t seq = sequence.load(std::memory_order_relaxed);
+        LatencyStamp merged = next_stamp;
+        #ifdef INSTRUMENTATION
+        if (consumed.load(std::memory_order_acquire) != seq) {
+            merge_latency_stamp(merged, stamp);
+        }
+        #endif
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = next;
+        stamp = merged;
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Reader side. Whether read_if_newer() would find anything, mid publish
+    // included
+    bool has_newer(uint32_t last_sequence) {
+        return sequence.load(std::memory_order_acquire) != last_sequence;
+    }
+
+    // Reader side. Copies the newest report into out if it was published
+    // after last_sequence, and moves last_sequence along with it.
+    bool read_if_newer(report &out, LatencyStamp &out_stamp, uint32_t &last_sequence) {
+        while (true) {
+            const uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before == last_sequence) {
+                return false;
+            }
+            if (before & 1) [[unlikely]] {
+                continue;  // Mid publish
+            }
+            const report copy = value;
+            const LatencyStamp stamp_copy = stamp;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) [[likely]] {
+                out = copy;
+                out_stamp = stamp_copy;
+                last_sequence = before;
+                #ifdef INSTRUMENTATION
+                consumed.store(before, std::memory_order_release);
+                #endif
+                return true;
+            }
+        }
+    }
+};
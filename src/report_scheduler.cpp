@@ -0,0 +1,121 @@
+#include "report_scheduler.hpp"
+
+ReportScheduler::ReportScheduler():
+    staged {},
+    in_flight {},
+    delivered {},
+    #ifdef DIAL_REPORT
+    confirmed {},
+    #endif
+    has_delivered(false),
+    busy(false)
+{ }
+
+report& ReportScheduler::get_staged() {
+    return staged;
+}
+
+#ifdef DIAL_REPORT
+// Clamps the unconfirmed distance to what one report can carry, the rest
+// waits for the next one
+static WireAxisValue dial_delta(AxisValue position, AxisValue confirmed) {
+    constexpr int32_t limit = (1 << (REPORT_AXIS_BITS - 1)) - 1;
+    // Wrap-safe. Rounds towards zero, so a fraction of a step waits either way
+    int32_t delta = (int32_t)(position - confirmed) / (1 << REPORT_AXIS_SHIFT);
+    delta = delta > limit ? limit : (delta < -limit ? -limit : delta);
+    return (WireAxisValue)delta;
+}
+#endif
+
+void ReportScheduler::make_wire_report(wire_report &out) {
+    out.button_bitmap = staged.button_bitmap;
+    for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+        #ifdef DIAL_REPORT
+        out.axes[slot] = dial_delta(staged.axes[slot], confirmed[slot]);
+        #else
+        out.axes[slot] = staged.axes[slot];
+        #endif
+    }
+}
+
+// The staged report as it would go on the bus, without sending it. Relative
+// axes read back as zero, since nothing would confirm they arrived.
+wire_report ReportScheduler::peek() {
+    wire_report out;
+    make_wire_report(out);
+    #ifdef DIAL_REPORT
+    for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+        out.axes[slot] = 0;
+    }
+    #endif
+    return out;
+}
+
+// Fields of the staged report that differ from what the host last received
+uint32_t ReportScheduler::dirty_fields() {
+    uint32_t fields = 0;
+    fields |= staged.button_bitmap != delivered.button_bitmap ? REPORT_FIELD_BUTTON_BITMAP : 0;
+    for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+        #ifdef DIAL_REPORT
+        fields |= dial_delta(staged.axes[slot], confirmed[slot]) != 0 ? REPORT_FIELD_AXIS(slot) : 0;
+        #else
+        fields |= staged.axes[slot] != delivered.axes[slot] ? REPORT_FIELD_AXIS(slot) : 0;
+        #endif
+    }
+    if (!has_delivered) {
+        #ifdef DIAL_REPORT
+        fields |= REPORT_FIELD_BUTTON_BITMAP;  // Zero deltas, but the host gets the buttons
+        #else
+        fields = REPORT_FIELDS_ALL;
+        #endif
+    }
+    return fields;
+}
+
+// Returns the report to hand to the endpoint, or nullptr if a transfer is
+// still in flight or the host already has the staged state. The caller must
+// follow up with complete_send() once the transfer finishes, or
+// cancel_send() if it could not be queued.
+const wire_report* ReportScheduler::begin_send() {
+    if (busy || dirty_fields() == 0) {
+        return nullptr;
+    }
+    make_wire_report(in_flight);
+    busy = true;
+    return &in_flight;
+}
+
+void ReportScheduler::cancel_send() {
+    busy = false;
+}
+
+void ReportScheduler::complete_send() {
+    if (!busy) [[unlikely]] {
+        return;
+    }
+    delivered = in_flight;
+    #ifdef DIAL_REPORT
+    for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+        confirmed[slot] += (AxisValue)(in_flight.axes[slot] * (1 << REPORT_AXIS_SHIFT));
+    }
+    #endif
+    has_delivered = true;
+    busy = false;
+}
+
+// Forget what the host has seen, e.g. after a bus reset, so that the full
+// state is sent again. Relative motion the old host never confirmed is
+// dropped rather than replayed to the new one.
+void ReportScheduler::reset() {
+    #ifdef DIAL_REPORT
+    for (uint slot = 0; slot < CONTROLLER_NUM_AXES; ++slot) {
+        confirmed[slot] = staged.axes[slot];
+    }
+    #endif
+    has_delivered = false;
+    busy = false;
+}
+
+bool ReportScheduler::is_busy() {
+    return busy;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "report.hpp"
+
+#define REPORT_FIELD_BUTTON_BITMAP (1u << 0)
+#define REPORT_FIELD_AXIS(slot) (1u << (1 + (slot)))  // slot as in report::axes
+#define REPORT_FIELDS_ALL (REPORT_FIELD_AXIS(CONTROLLER_NUM_AXES) - 1)
+
+// Owns the input report between the handlers and the IN endpoint. Handlers
+// overwrite the staged report whenever they like (latest wins). A copy goes
+// on the bus only when no transfer is in flight and the staged report
+// differs from the one the host last received, so a busy endpoint delays
+// a change rather than losing it, and identical reports are never resent.
+//
+// With DIAL_REPORT an axis counts as changed while its staged position is
+// away from the one the host has confirmed. Each report carries as much of
+// that distance as fits, and only a completed transfer moves the confirmed
+// position on, so motion is never lost however slowly the host reads.
+class ReportScheduler {
+private:
+    report staged;
+    wire_report in_flight;
+    wire_report delivered;
+    #ifdef DIAL_REPORT
+    AxisValue confirmed[CONTROLLER_NUM_AXES];  // Staged positions the host has seen all of
+    #endif
+    bool has_delivered;  // False until the first transfer after a reset completes
+    bool busy;
+
+    void make_wire_report(wire_report &out);
+
+public:
+    ReportScheduler();
+    report& get_staged();
+    wire_report peek();
+    uint32_t dirty_fields();
+    const wire_report* begin_send();
+    void cancel_send();
+    void complete_send();
+    void reset();
+    bool is_busy();
+};
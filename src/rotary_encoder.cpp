@@ -1,187 +1,177 @@
+#include <utility>
 #include "rotary_encoder.hpp"
+#include "flight_recorder.hpp"
 
-RotaryTransitionCounter::RotaryTransitionCounter():
-    counts {0, 0}
-{ }
+void QuadratureDecoder::reset(RotaryEncoderState state) {
+    last_state = state;
+}
+
+RotaryEncoderState QuadratureDecoder::get_state() {
+    return (RotaryEncoderState)last_state;
+}
 
-void RotaryTransitionCounter::observe(RotaryEncoderTransition transition) {
-    ++counts[transition];
+// Rejects windows the shift register can not hold and consensus counts the
+// window can never reach
+bool QuadratureDecoder::is_valid_consensus(uint debounce_count, uint consensus_count) {
+    return debounce_count >= 1 && debounce_count <= ROTARY_ENCODER_MAX_DEBOUNCE_COUNT
+        && consensus_count >= 1 && consensus_count <= debounce_count;
 }
 
-bool RotaryTransitionCounter::unobserve(RotaryEncoderTransition transition) {
-    if (counts[transition] == 0) [[unlikely]] {
+bool QuadratureDecoder::set_consensus(uint debounce_count, uint consensus_count) {
+    if (!is_valid_consensus(debounce_count, consensus_count)) {
         return false;
     }
-    else [[likely]] {
-        --counts[transition];
-        return true;
+    this->debounce_count = debounce_count;
+    this->consensus_count = consensus_count;
+    window_mask = (uint32_t)((1ull << debounce_count) - 1);
+    // Old transitions would count against the new window
+    window_right &= window_mask;
+    window_filled &= window_mask;
+    return true;
+}
+
+uint QuadratureDecoder::get_debounce_count() {
+    return debounce_count;
+}
+
+uint QuadratureDecoder::get_consensus_count() {
+    return consensus_count;
+}
+
+RotaryEncoderDecision QuadratureDecoder::decode(RotaryEncoderState next_state, uint32_t now) {
+    if (last_state == UNKNOWN) [[unlikely]] {
+        panic("Rotary encoder last known state is uninitialized!\n");
     }
+    const uint8_t transition = QUADRATURE_TRANSITIONS[(last_state << 2) | next_state];
+    if (!(transition & QUADRATURE_TRANSITION_VALID)) [[unlikely]] {
+        if (next_state == last_state) {
+            return DECODE_UNCHANGED;
+        }
+        // The direction of a skipped step is unknowable, but the levels are
+        // not, so pick up from them rather than waiting for a lucky edge
+        last_state = next_state;
+        ++missed_transitions;
+        return DECODE_INVALID;
+    }
+
+    last_state = next_state;
+
+    const bool right = transition & QUADRATURE_TRANSITION_RIGHT;
+    window_right = ((window_right << 1) | right) & window_mask;
+    window_filled = ((window_filled << 1) | 1) & window_mask;
+    const uint32_t agreeing = right ? window_right : (~window_right & window_filled);
+    if (popcount32(agreeing) < consensus_count) {
+        return DECODE_NO_CONSENSUS;
+    }
+    uint32_t gap = now - last_tick_time;  // Wrap-safe
+    pending_span_us += gap < ROTARY_ENCODER_MAX_TICK_GAP_US ? gap : ROTARY_ENCODER_MAX_TICK_GAP_US;
+    pending_ticks += right ? 1 : -1;
+    ++pending_transitions;
+    last_tick_time = now;
+    return right ? DECODE_ROTATE_RIGHT : DECODE_ROTATE_LEFT;
 }
 
-uint RotaryTransitionCounter::count(RotaryEncoderTransition transition) {
-    return counts[transition];
+// Ticks counted somewhere else, like the PIO, that all turned up by now.
+// They are spread evenly over the time since the last tick.
+void QuadratureDecoder::add_counted_ticks(int32_t ticks, uint32_t now) {
+    if (ticks == 0) {
+        return;
+    }
+    const uint32_t transitions = ticks < 0 ? -ticks : ticks;
+    const uint64_t max_span = (uint64_t)ROTARY_ENCODER_MAX_TICK_GAP_US * transitions;
+    const uint32_t gap = now - last_tick_time;  // Wrap-safe
+    pending_span_us += gap < max_span ? gap : (uint32_t)max_span;
+    pending_ticks += ticks;
+    pending_transitions += transitions;
+    last_tick_time = now;
 }
 
-RotaryEncoder::RotaryEncoder(uint gpio_pin_left, uint gpio_pin_right, Joystick* joystick):
-    gpio_pin_left(gpio_pin_left),
-    gpio_pin_right(gpio_pin_right),
-    transition_buffer(ROTARY_ENCODER_TRANSITION_BUFFERS[num_rotary_encoders], ROTARY_ENCODER_DEBOUNCE_COUNT),
-    last_state(UNKNOWN),
-    transitions(),
-    last_state_update(0),
-    last_read_ok(true),
-    joystick(joystick)
-{
-    if (++num_rotary_encoders > MAX_ROTARY_ENCODERS) [[unlikely]] {
-        panic("Number of rotary encoders (%u) exceeds maximum (%u)!\n", num_rotary_encoders, MAX_ROTARY_ENCODERS);
+// Hands over the net ticks counted since the last call, along with the
+// average gap between them for velocity scaling.
+int32_t QuadratureDecoder::take_ticks(uint32_t &interval_us) {
+    const int32_t ticks = pending_ticks;
+    if (pending_transitions != 0) {
+        interval_us = pending_span_us / pending_transitions;
     }
+    pending_ticks = 0;
+    pending_transitions = 0;
+    pending_span_us = 0;
+    return ticks;
+}
+
+bool QuadratureDecoder::has_pending_ticks() {
+    return pending_ticks != 0;
+}
+
+uint32_t QuadratureDecoder::get_missed_transitions() {
+    return missed_transitions;
+}
+
+
+template <size_t... INDICES>
+static constexpr std::array<RotaryEncoder, CONTROLLER_NUM_ENCODERS> make_rotary_encoders(std::index_sequence<INDICES...>) {
+    return {{ RotaryEncoder(CONTROLLER_LAYOUT.encoders[INDICES])... }};
+}
+
+static constexpr std::array<RotaryEncoder, CONTROLLER_NUM_ENCODERS> LAYOUT_ROTARY_ENCODERS = make_rotary_encoders(std::make_index_sequence<CONTROLLER_NUM_ENCODERS>());
+static std::array<RotaryEncoder, CONTROLLER_NUM_ENCODERS> ROTARY_ENCODERS = LAYOUT_ROTARY_ENCODERS;
+
+void RotaryEncoder::init_pins() {
+    #ifdef PIO_ENCODERS
+    pio_sm = (uint8_t)start_quadrature_pio(gpio_pin_left);
+    pio_count = (uint32_t)read_quadrature_pio_count(pio_sm);
+    #else
     gpio_init(gpio_pin_left);
     gpio_init(gpio_pin_right);
     gpio_set_dir(gpio_pin_left, GPIO_IN);
     gpio_set_dir(gpio_pin_right, GPIO_IN);
-    refresh_state();
+    #endif
+    refresh_state(gpio_get_all());
 }
 
-bool RotaryEncoder::handle_event(const TimedRotaryEncoderEvent &event) {
-    std::optional<RotaryEncoderState> next_state = std::nullopt;
-    std::optional<RotaryEncoderTransition> transition = std::nullopt;
-    uint64_t now = event.time;
-    uint64_t diff = now - last_state_update;
-    bool fast = diff < MIN_US_DIFF_TO_SEND;
-    switch (last_state) {
-        case BOTH_DOWN:
-            switch (event.event) {
-                case LEFT_EDGE_RISE:
-                    next_state.emplace(LEFT_UP);
-                    transition.emplace(ROTATE_LEFT);
-                    break;
-                case RIGHT_EDGE_RISE:
-                    next_state.emplace(RIGHT_UP);
-                    transition.emplace(ROTATE_RIGHT);
-                    break;
-            }
+RotaryEncoderDecision RotaryEncoder::handle_event(const TimedRotaryEncoderEvent &event) {
+    const RotaryEncoderDecision decision = decoder.decode(event.state, event.time);
+    // Printing would disturb the timing the flight recorder is there to capture
+    #if defined(DEBUG_MODE) && !defined(FLIGHT_RECORDER)
+    switch (decision) {
+        case DECODE_ROTATE_LEFT:
+            printf("L\n");
             break;
-        case LEFT_UP:
-            switch (event.event) {
-                case LEFT_EDGE_FALL:
-                    next_state.emplace(BOTH_DOWN);
-                    transition.emplace(ROTATE_RIGHT);
-                    break;
-                case RIGHT_EDGE_RISE:
-                    next_state.emplace(BOTH_UP);
-                    transition.emplace(ROTATE_LEFT);
-                    break;
-            }
+        case DECODE_ROTATE_RIGHT:
+            printf("R\n");
             break;
-        case RIGHT_UP:
-            switch (event.event) {
-                case LEFT_EDGE_RISE:
-                    next_state.emplace(BOTH_UP);
-                    transition.emplace(ROTATE_RIGHT);
-                    break;
-                case RIGHT_EDGE_FALL:
-                    next_state.emplace(BOTH_DOWN);
-                    transition.emplace(ROTATE_LEFT);
-                    break;
-            }
+        [[unlikely]] case DECODE_INVALID:
+            printf("r");
             break;
-        case BOTH_UP:
-            switch (event.event) {
-                case LEFT_EDGE_FALL:
-                    next_state.emplace(RIGHT_UP);
-                    transition.emplace(ROTATE_LEFT);
-                    break;
-                case RIGHT_EDGE_FALL:
-                    next_state.emplace(LEFT_UP);
-                    transition.emplace(ROTATE_RIGHT);
-                    break;
-            }
+        default:
             break;
-        [[unlikely]] case UNKNOWN: 
-            panic("Rotary encoder last known state is uninitialized!\n");
     }
+    #endif
+    return decision;
+}
 
-    if (next_state.has_value()) [[likely]] {
-        last_state_update = now;
-        last_state = next_state.value();
-        if (!last_read_ok) {
-            last_read_ok = true;
-            return true;  // Last read was an error
-        }
-        if (fast) {
-            return true;  // Too fast to send
-        }
-        if (transition.has_value()) {
-            std::optional<RotaryEncoderTransition> popped = transition_buffer.push(transition.value());
-            transitions.observe(transition.value());
-            if (popped.has_value()) {
-                transitions.unobserve(popped.value());
-            }
-            if (transitions.count(transition.value()) >= ROTARY_ENCODER_CONSENSUS_COUNT) {
-                switch (transition.value()) {
-                    case ROTATE_LEFT:
-                        #ifdef DEBUG_MODE
-                        printf("L\n");
-                        #endif
-                        joystick->handle_encoder_left_rotation();
-                        break;
-                    case ROTATE_RIGHT:
-                        #ifdef DEBUG_MODE
-                        printf("R\n");
-                        #endif
-                        joystick->handle_encoder_right_rotation();
-                        break;
-                }
-            }
-        }
-        return true;
-    }
-    else [[unlikely]] {
-        last_read_ok = false;
-        #ifdef DEBUG_MODE
-        printf("r");
-        #endif
-        return false;
+void RotaryEncoder::emit_rotation(Joystick &joystick) {
+    #ifdef PIO_ENCODERS
+    const uint32_t count = (uint32_t)read_quadrature_pio_count(pio_sm);
+    decoder.add_counted_ticks((int32_t)(count - pio_count), time_us_32());
+    pio_count = count;
+    #endif
+    uint32_t interval_us = 0;
+    const int32_t ticks = decoder.take_ticks(interval_us);
+    if (ticks != 0) {
+        joystick.handle_encoder_rotation(axis_slot, ticks, interval_us);
     }
 }
 
-void RotaryEncoder::refresh_state() {
-    if (gpio_get(gpio_pin_left)) {
-        if (gpio_get(gpio_pin_right)) {
-            last_state = BOTH_UP;
-        }
-        else {
-            last_state = LEFT_UP;
-        }
-    }
-    else {
-        if (gpio_get(gpio_pin_right)) {
-            last_state = RIGHT_UP;
-        }
-        else {
-            last_state = BOTH_DOWN;
-        }
-    }
+// Starts the decoder over from levels, a gpio_get_all() read
+void RotaryEncoder::refresh_state(uint32_t levels) {
+    decoder.reset(state_from_levels(levels));
 }
 
-bool RotaryEncoder::create_and_register(uint gpio_pin_left, uint gpio_pin_right, Joystick* joystick) {
-    if (!ROTARY_ENCODER_STATICS_INITIALIZED) {
-        panic("Attempted to create a Rotary Encoder handler before initializing statics\n");
-    }
-    if (num_rotary_encoders < MAX_ROTARY_ENCODERS) {
-        if (PIN_TO_ROTARY_ENCODER_HANDLER_MAP[gpio_pin_left].has_value()) {
-            return false;
-        }
-        if (PIN_TO_ROTARY_ENCODER_HANDLER_MAP[gpio_pin_right].has_value()) {
-            return false;
-        }
-        const uint index = num_rotary_encoders;
-        ROTARY_ENCODERS[index] = RotaryEncoder(gpio_pin_left, gpio_pin_right, joystick);
-        PIN_TO_ROTARY_ENCODER_HANDLER_MAP[gpio_pin_left] = index;
-        PIN_TO_ROTARY_ENCODER_HANDLER_MAP[gpio_pin_right] = index;
-        return true;
-    }
-    return false;
+RotaryEncoderState RotaryEncoder::state_from_levels(uint32_t levels) {
+    uint left = (levels >> gpio_pin_left) & 1;
+    uint right = (levels >> gpio_pin_right) & 1;
+    return (RotaryEncoderState)(left | (right << 1));
 }
 
 uint RotaryEncoder::get_left_pin() {
@@ -192,65 +182,83 @@ uint RotaryEncoder::get_right_pin() {
     return gpio_pin_right;
 }
 
-uint RotaryEncoder::num_rotary_encoders = 0;
+uint RotaryEncoder::get_axis_slot() {
+    return axis_slot;
+}
+
+uint32_t RotaryEncoder::get_missed_transitions() {
+    return decoder.get_missed_transitions();
+}
+
+QuadratureDecoder& RotaryEncoder::get_decoder() {
+    return decoder;
+}
 
+// Starts every encoder in CONTROLLER_LAYOUT over from its pin levels with
+// the default tuning
 void init_rotary_encoder_handling() {
-    for (uint encoder = 0; encoder < MAX_ROTARY_ENCODERS; ++encoder) {
-        for (uint debounce_index = 0; debounce_index < ROTARY_ENCODER_EVENT_BUFFER_LEN; ++debounce_index) {
-            ROTARY_ENCODER_TRANSITION_BUFFERS[encoder][debounce_index] = std::nullopt;
-        }
-        ROTARY_ENCODERS[encoder] = std::nullopt;
+    #ifdef PIO_ENCODERS
+    load_quadrature_pio_program();
+    #endif
+    ROTARY_ENCODERS = LAYOUT_ROTARY_ENCODERS;
+    for (RotaryEncoder &encoder : ROTARY_ENCODERS) {
+        encoder.init_pins();
     }
+}
 
-    for (uint pin = 0; pin < MAX_GPIO_PINS; ++pin) {
-        PIN_TO_ROTARY_ENCODER_HANDLER_MAP[pin] = std::nullopt;
+// nullptr if the layout has no such encoder
+RotaryEncoder* get_rotary_encoder(uint index) {
+    return index < CONTROLLER_NUM_ENCODERS ? &ROTARY_ENCODERS[index] : nullptr;
+}
+
+void handle_rotary_encoder_event(PinHandler handler, const Event &event) {
+    RotaryEncoder& rotary_encoder = ROTARY_ENCODERS[handler.index];
+    const RotaryEncoderState before = rotary_encoder.get_decoder().get_state();
+    // The snapshot holds both channels, so which edge fired no longer matters
+    const RotaryEncoderState after = rotary_encoder.state_from_levels(event.levels);
+    const RotaryEncoderDecision decision = rotary_encoder.handle_event(TimedRotaryEncoderEvent { after, event.time });
+    record_flight(handler.index, event, before, after, decision);
+}
+
+// Picks the decoder up from the pins, after events it needed were dropped.
+// Whatever the lost edges moved is gone, but nothing after them is misread.
+void resync_rotary_encoder(PinHandler handler, uint32_t levels) {
+    ROTARY_ENCODERS[handler.index].refresh_state(levels);
+}
+
+void emit_rotary_encoder_rotations() {
+    Joystick &joystick = *get_joystick();
+    for (RotaryEncoder &encoder : ROTARY_ENCODERS) {
+        encoder.emit_rotation(joystick);
     }
-    ROTARY_ENCODER_STATICS_INITIALIZED = true;
 }
 
-void handle_rotary_encoder_event(const Event &event) {
-    uint gpio = event.gpio;
-    uint32_t event_mask = event.mask;
-    uint64_t at = event.time;
-    std::optional<uint> rotary_encoder_index = PIN_TO_ROTARY_ENCODER_HANDLER_MAP[gpio];
-    if (rotary_encoder_index.has_value()) {
-        RotaryEncoder& rotary_encoder = ROTARY_ENCODERS[rotary_encoder_index.value()].value();
-        bool edge_fall = event_mask & GPIO_IRQ_EDGE_FALL;
-        bool edge_rise = event_mask & GPIO_IRQ_EDGE_RISE;
-        if (edge_fall && edge_rise) {
-            // do nothing...
-        }
-        else if (edge_fall) {
-            if (gpio == rotary_encoder.get_left_pin()) {
-                rotary_encoder.handle_event(TimedRotaryEncoderEvent { LEFT_EDGE_FALL, at });
-            }
-            else if (gpio == rotary_encoder.get_right_pin()) {
-                rotary_encoder.handle_event(TimedRotaryEncoderEvent { RIGHT_EDGE_FALL, at });
-            }
-            else {
-                panic("gpio pin %u is mapped to rotary encoder %u, but neither of its pins match!", gpio, rotary_encoder_index.value());
-            }
-        }
-        else if (edge_rise) {
-            if (gpio == rotary_encoder.get_left_pin()) {
-                rotary_encoder.handle_event(TimedRotaryEncoderEvent { LEFT_EDGE_RISE, at });
-            }
-            else if (gpio == rotary_encoder.get_right_pin()) {
-                rotary_encoder.handle_event(TimedRotaryEncoderEvent { RIGHT_EDGE_RISE, at });
-            }
-            else {
-                panic("gpio pin %u is mapped to rotary encoder %u, but neither of its pins match!", gpio, rotary_encoder_index.value());
-            }
+// Decoded motion that emit_rotary_encoder_rotations() has not passed on yet
+bool rotary_encoders_have_pending_ticks() {
+    for (RotaryEncoder &encoder : ROTARY_ENCODERS) {
+        if (encoder.get_decoder().has_pending_ticks()) {
+            return true;
         }
     }
+    return false;
 }
 
-void enable_rotary_encoder_irq() {
-    for (uint encoder_index = 0; encoder_index < MAX_ROTARY_ENCODERS; ++encoder_index) {
-        std::optional<RotaryEncoder>& encoder = ROTARY_ENCODERS[encoder_index];
-        if (encoder.has_value()) {
-            gpio_set_irq_enabled(encoder.value().get_left_pin(), GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
-            gpio_set_irq_enabled(encoder.value().get_right_pin(), GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
-        }
+// Applies to every encoder, returns false and changes nothing if the values
+// are out of range
+bool set_rotary_encoder_consensus(uint debounce_count, uint consensus_count) {
+    if (!QuadratureDecoder::is_valid_consensus(debounce_count, consensus_count)) {
+        return false;
+    }
+    for (RotaryEncoder &encoder : ROTARY_ENCODERS) {
+        encoder.get_decoder().set_consensus(debounce_count, consensus_count);
     }
+    return true;
+}
+
+uint get_rotary_encoder_debounce_count() {
+    return CONTROLLER_NUM_ENCODERS > 0 ? ROTARY_ENCODERS[0].get_decoder().get_debounce_count() : ROTARY_ENCODER_DEBOUNCE_COUNT;
+}
+
+uint get_rotary_encoder_consensus_count() {
+    return CONTROLLER_NUM_ENCODERS > 0 ? ROTARY_ENCODERS[0].get_decoder().get_consensus_count() : ROTARY_ENCODER_CONSENSUS_COUNT;
 }
@@ -1,35 +1,38 @@
 #pragma once
-#include <optional>
+#include <array>
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "buffer.hpp"
 #include "const.hpp"
+#include "controller_layout.hpp"
+#include "dispatch.hpp"
 #include "event.hpp"
 #include "joystick.hpp"
-#define ROTARY_ENCODER_EVENT_BUFFER_LEN 256
+#ifdef PIO_ENCODERS
+#include "quadrature_pio.hpp"
+#endif
 #define ROTARY_ENCODER_DEBOUNCE_COUNT 2
 #define ROTARY_ENCODER_CONSENSUS_COUNT 2
-#define MAX_ROTARY_ENCODERS 2
-#define MIN_US_DIFF_TO_SEND 800llu
+#define ROTARY_ENCODER_MAX_TICK_GAP_US 65536u  // Longer pauses count as this long when averaging tick speed
 
-enum RotaryEncoderState {
-    BOTH_DOWN,
-    LEFT_UP,
-    RIGHT_UP,
-    BOTH_UP,
-    UNKNOWN,
-};
+#define ROTARY_ENCODER_MAX_DEBOUNCE_COUNT 32  // The consensus window is a 32-bit shift register
 
-enum RotaryEncoderEvent {
-    LEFT_EDGE_FALL,
-    LEFT_EDGE_RISE,
-    RIGHT_EDGE_FALL,
-    RIGHT_EDGE_RISE,
+static_assert(ROTARY_ENCODER_DEBOUNCE_COUNT <= ROTARY_ENCODER_MAX_DEBOUNCE_COUNT, "The consensus window is a 32-bit shift register");
+static_assert(ROTARY_ENCODER_CONSENSUS_COUNT >= 1 && ROTARY_ENCODER_CONSENSUS_COUNT <= ROTARY_ENCODER_DEBOUNCE_COUNT, "Consensus must fit in the window");
+
+// Values double as pin levels: bit 0 is the left pin, bit 1 the right pin
+enum RotaryEncoderState {
+    BOTH_DOWN = 0,
+    LEFT_UP = 1,
+    RIGHT_UP = 2,
+    BOTH_UP = 3,
+    UNKNOWN = 4,
 };
 
+// Both pin levels as sampled in the ISR when one of them changed
 struct TimedRotaryEncoderEvent {
-    RotaryEncoderEvent event;
-    uint64_t time;
+    RotaryEncoderState state;
+    uint32_t time;
 };
 
 enum RotaryEncoderTransition {
@@ -37,44 +40,146 @@ enum RotaryEncoderTransition {
     ROTATE_RIGHT = 1,
 };
 
-class RotaryTransitionCounter {
-    friend class RotaryEncoder;
+// Stored in flight recorder dumps, only ever append
+enum RotaryEncoderDecision {
+    DECODE_UNCHANGED,  // Pins read back the last known state, the edge bounced
+    DECODE_INVALID,  // Both pins changed, an edge was missed. Resynchronised to the new state
+    DECODE_NO_CONSENSUS,
+    DECODE_ROTATE_LEFT,
+    DECODE_ROTATE_RIGHT,
+};
+
+#define QUADRATURE_TRANSITION_VALID 0x1
+#define QUADRATURE_TRANSITION_RIGHT 0x2
+
+// Indexed by (previous state << 2) | next state
+constexpr uint8_t QUADRATURE_TRANSITIONS[16] = {
+    0,                                                          // BOTH_DOWN -> BOTH_DOWN
+    QUADRATURE_TRANSITION_VALID,                                // BOTH_DOWN -> LEFT_UP
+    QUADRATURE_TRANSITION_VALID | QUADRATURE_TRANSITION_RIGHT,  // BOTH_DOWN -> RIGHT_UP
+    0,                                                          // BOTH_DOWN -> BOTH_UP
+    QUADRATURE_TRANSITION_VALID | QUADRATURE_TRANSITION_RIGHT,  // LEFT_UP -> BOTH_DOWN
+    0,                                                          // LEFT_UP -> LEFT_UP
+    0,                                                          // LEFT_UP -> RIGHT_UP
+    QUADRATURE_TRANSITION_VALID,                                // LEFT_UP -> BOTH_UP
+    QUADRATURE_TRANSITION_VALID,                                // RIGHT_UP -> BOTH_DOWN
+    0,                                                          // RIGHT_UP -> LEFT_UP
+    0,                                                          // RIGHT_UP -> RIGHT_UP
+    QUADRATURE_TRANSITION_VALID | QUADRATURE_TRANSITION_RIGHT,  // RIGHT_UP -> BOTH_UP
+    0,                                                          // BOTH_UP -> BOTH_DOWN
+    QUADRATURE_TRANSITION_VALID | QUADRATURE_TRANSITION_RIGHT,  // BOTH_UP -> LEFT_UP
+    QUADRATURE_TRANSITION_VALID,                                // BOTH_UP -> RIGHT_UP
+    0,                                                          // BOTH_UP -> BOTH_UP
+};
+
+// Branch-free popcount. __builtin_popcount is a libgcc call on the M0+.
+static inline uint popcount32(uint32_t bits) {
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0Fu;
+    return (bits * 0x01010101u) >> 24;
+}
+
+// The pin-independent half of a rotary encoder: turns pin level changes into
+// rotation decisions. A transition only counts once consensus_count of the
+// last debounce_count transitions agree with it (ROTARY_ENCODER_CONSENSUS_COUNT
+// of ROTARY_ENCODER_DEBOUNCE_COUNT unless retuned). Counted transitions
+// accumulate as signed ticks until the emission stage takes them, however
+// fast they arrive.
+class QuadratureDecoder {
 private:
-    uint counts[2];
-    RotaryTransitionCounter();
-    void observe(RotaryEncoderTransition transition);
-    bool unobserve(RotaryEncoderTransition transition);
-    uint count(RotaryEncoderTransition transition);
+    uint8_t last_state;
+    uint8_t debounce_count;
+    uint8_t consensus_count;
+    uint32_t window_mask;
+    uint32_t window_right;  // 1 = rotated right, newest transition in bit 0
+    uint32_t window_filled;  // 1 = slot holds a transition
+    int32_t pending_ticks;  // Positive = right
+    uint32_t pending_transitions;  // Counted either way, for the average
+    uint32_t pending_span_us;  // Sum of the gaps before each pending tick
+    uint32_t last_tick_time;
+    uint32_t missed_transitions;
+
+public:
+    constexpr QuadratureDecoder():
+        last_state(UNKNOWN),
+        debounce_count(ROTARY_ENCODER_DEBOUNCE_COUNT),
+        consensus_count(ROTARY_ENCODER_CONSENSUS_COUNT),
+        window_mask((uint32_t)((1ull << ROTARY_ENCODER_DEBOUNCE_COUNT) - 1)),
+        window_right(0),
+        window_filled(0),
+        pending_ticks(0),
+        pending_transitions(0),
+        pending_span_us(0),
+        last_tick_time(0),
+        missed_transitions(0)
+    { }
+
+    static bool is_valid_consensus(uint debounce_count, uint consensus_count);
+    void reset(RotaryEncoderState state);
+    RotaryEncoderState get_state();
+    bool set_consensus(uint debounce_count, uint consensus_count);
+    uint get_debounce_count();
+    uint get_consensus_count();
+    RotaryEncoderDecision decode(RotaryEncoderState next_state, uint32_t now);
+    void add_counted_ticks(int32_t ticks, uint32_t now);
+    int32_t take_ticks(uint32_t &interval_us);
+    bool has_pending_ticks();
+    uint32_t get_missed_transitions();
 };
 
+// One encoder of CONTROLLER_LAYOUT. Constructing one touches no hardware,
+// init_pins() claims the pins and picks up their levels.
+//
+// With PIO_ENCODERS a PIO state machine counts the transitions instead of
+// the pin events, and emit_rotation() reads the count once per report. The
+// consensus window does not apply there, since every bounce the PIO counts
+// it also counts back.
 class RotaryEncoder {
 private:
-    static uint num_rotary_encoders;
-    uint gpio_pin_left;
-    uint gpio_pin_right;
-    CircularOverflowBuffer<RotaryEncoderTransition> transition_buffer;
-    RotaryEncoderState last_state;
-    RotaryTransitionCounter transitions;
-    uint64_t last_state_update;
-    bool last_read_ok;
-    Joystick* joystick;
-
-    RotaryEncoder(uint gpio_pin_left, uint gpio_pin_right, Joystick* joystick);
-    void refresh_state();
+    uint8_t gpio_pin_left;
+    uint8_t gpio_pin_right;
+    uint8_t axis_slot;  // Where its axis sits in the report
+    QuadratureDecoder decoder;
+    #ifdef PIO_ENCODERS
+    uint8_t pio_sm;
+    uint32_t pio_count;  // As of the last emit_rotation(), wraps
+    #endif
 
 public:
-    
-    static bool create_and_register(uint gpio_pin_left, uint gpio_pin_right, Joystick* joystick);
-    bool handle_event(const TimedRotaryEncoderEvent &event);
+    constexpr RotaryEncoder(const EncoderLayout &layout):
+        gpio_pin_left(layout.gpio_left),
+        gpio_pin_right(layout.gpio_right),
+        axis_slot((uint8_t)axis_mask_slot(CONTROLLER_AXIS_MASK, layout.axis)),
+        decoder()
+        #ifdef PIO_ENCODERS
+        , pio_sm(0),
+        pio_count(0)
+        #endif
+    { }
+
+    void init_pins();
+    void refresh_state(uint32_t levels);
+    RotaryEncoderState state_from_levels(uint32_t levels);
+    RotaryEncoderDecision handle_event(const TimedRotaryEncoderEvent &event);
+    void emit_rotation(Joystick &joystick);
     uint get_left_pin();
     uint get_right_pin();
+    uint get_axis_slot();
+    uint32_t get_missed_transitions();
+    QuadratureDecoder& get_decoder();
 };
 
-static std::optional<RotaryEncoderTransition> ROTARY_ENCODER_TRANSITION_BUFFERS[MAX_ROTARY_ENCODERS][ROTARY_ENCODER_DEBOUNCE_COUNT];
-static std::optional<RotaryEncoder> ROTARY_ENCODERS[MAX_ROTARY_ENCODERS];
-static std::optional<uint> PIN_TO_ROTARY_ENCODER_HANDLER_MAP[MAX_GPIO_PINS];
-static bool ROTARY_ENCODER_STATICS_INITIALIZED = false;
+#ifdef PIO_ENCODERS
+static_assert(is_quadrature_pio_layout(CONTROLLER_LAYOUT), "PIO_ENCODERS needs each right pin next to its left pin, and a state machine per encoder");
+#endif
 
 void init_rotary_encoder_handling();
-void handle_rotary_encoder_event(const Event &event);
-void enable_rotary_encoder_irq();
+RotaryEncoder* get_rotary_encoder(uint index);
+void handle_rotary_encoder_event(PinHandler handler, const Event &event);
+void resync_rotary_encoder(PinHandler handler, uint32_t levels);
+void emit_rotary_encoder_rotations();
+bool rotary_encoders_have_pending_ticks();
+bool set_rotary_encoder_consensus(uint debounce_count, uint consensus_count);
+uint get_rotary_encoder_debounce_count();
+uint get_rotary_encoder_consensus_count();
@@ -0,0 +1,78 @@
+#include "scanner.hpp"
+
+// Starts over with levels already debounced and every counter cleared
+void VerticalDebouncer::reset(uint32_t levels) {
+    state = levels;
+    count_low = 0;
+    count_high = 0;
+}
+
+// Takes one sample of every pin and returns the pins whose debounced level
+// flipped, which is the SCAN_DEBOUNCE_SAMPLES-th differing sample in a row
+uint32_t VerticalDebouncer::update(uint32_t sample) {
+    const uint32_t differs = sample ^ state;
+    // Counts 0, 1, 2, 3 and rolls over to 0 on the fourth, cleared wherever
+    // the pin agrees again
+    count_high = (count_high ^ count_low) & differs;
+    count_low = ~count_low & differs;
+    const uint32_t flipped = differs & ~(count_low | count_high);
+    state ^= flipped;
+    return flipped;
+}
+
+uint32_t VerticalDebouncer::get_state() {
+    return state;
+}
+
+static VerticalDebouncer SCAN_DEBOUNCER;
+static uint32_t SCAN_COUNT = 0;
+static alarm_pool_t* SCAN_ALARM_POOL = nullptr;
+static repeating_timer_t SCAN_TIMER;
+
+// One pass over every pin the layout uses. Each debounced change becomes an
+// event for the pin handlers, stamped with the pass and carrying the
+// debounced levels, so the handlers never see the raw bouncing.
+void scan_inputs() {
+    const uint32_t now = time_us_32();
+    const uint32_t flipped = SCAN_DEBOUNCER.update(gpio_get_all() & CONTROLLER_IRQ_MASK);
+    ++SCAN_COUNT;
+    if (flipped == 0) [[likely]] {
+        return;
+    }
+    const uint32_t levels = SCAN_DEBOUNCER.get_state();
+    for (uint32_t pins = flipped; pins != 0; pins &= pins - 1) {
+        const uint gpio = __builtin_ctz(pins);
+        push_event(Event(gpio, (levels >> gpio) & 1 ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL, now, levels));
+    }
+}
+
+static bool scan_timer_callback(repeating_timer_t *timer) {
+    (void)timer;
+    scan_inputs();
+    return true;
+}
+
+// Replaces the per-edge GPIO interrupt: samples every pin in the layout each
+// SCAN_PERIOD_US from a timer interrupt on the calling core, whatever the
+// pins are doing. levels are what the handlers last read, from
+// capture_input_state(). Any pin that has moved since then differs from
+// them and comes through as an event.
+void init_input_scan(uint32_t levels) {
+    SCAN_DEBOUNCER.reset(levels & CONTROLLER_IRQ_MASK);
+    SCAN_COUNT = 0;
+    if (SCAN_ALARM_POOL == nullptr) {
+        // The default pool fires on core 0, which is the wrong core in DUAL_CORE mode
+        SCAN_ALARM_POOL = alarm_pool_create_with_unused_hardware_alarm(1);
+    }
+    else {
+        cancel_repeating_timer(&SCAN_TIMER);
+    }
+    // Negative: start to start, so the rate holds however long a pass takes
+    if (!alarm_pool_add_repeating_timer_us(SCAN_ALARM_POOL, -SCAN_PERIOD_US, scan_timer_callback, nullptr, &SCAN_TIMER)) {
+        panic("Could not start the input scan timer!\n");
+    }
+}
+
+uint32_t get_scan_count() {
+    return SCAN_COUNT;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "controller_layout.hpp"
+#include "event.hpp"
+
+#define SCAN_PERIOD_US 25  // 40 kHz
+#define SCAN_DEBOUNCE_SAMPLES 4  // A pin must read the same this many scans in a row
+
+// One 2-bit counter per pin, stored bit-sliced: count_low holds bit 0 of
+// every pin's counter, count_high bit 1. A pin's counter runs while its sample
+// differs from its debounced level and is cleared as soon as they agree, so
+// update() debounces all 32 pins in a handful of word-wide operations.
+class VerticalDebouncer {
+private:
+    uint32_t state;  // Debounced levels
+    uint32_t count_low;
+    uint32_t count_high;
+
+public:
+    constexpr VerticalDebouncer():
+        state(0),
+        count_low(0),
+        count_high(0)
+    { }
+
+    void reset(uint32_t levels);
+    uint32_t update(uint32_t sample);
+    uint32_t get_state();
+};
+
+static_assert(SCAN_DEBOUNCE_SAMPLES == 4, "VerticalDebouncer counts with two bit planes");
+
+void init_input_scan(uint32_t levels);
+void scan_inputs();
+uint32_t get_scan_count();
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <string.h>
+#include "tuning.hpp"
+#include "joystick.hpp"
+#include "rotary_encoder.hpp"
+
+// Handed from the USB side to the input side. The USB side only writes
+// PENDING_TUNING while the flag is clear and the input side only reads it
+// while the flag is set, so the two never touch it at once.
+static TuningReport PENDING_TUNING;
+static std::atomic<bool> TUNING_PENDING { false };
+
+static bool is_valid_tuning(const TuningReport &tuning) {
+    return tuning.version == TUNING_REPORT_VERSION
+        && QuadratureDecoder::is_valid_consensus(tuning.encoder_debounce_count, tuning.encoder_consensus_count)
+        && Joystick::is_valid_sensitivity(tuning.joystick_sensitivity, tuning.joystick_max_sensitivity);
+}
+
+uint16_t get_tuning_report(uint8_t* buffer, uint16_t reqlen) {
+    TuningReport tuning;
+    tuning.version = TUNING_REPORT_VERSION;
+    tuning.encoder_debounce_count = get_rotary_encoder_debounce_count();
+    tuning.encoder_consensus_count = get_rotary_encoder_consensus_count();
+    tuning.joystick_sensitivity = get_joystick_sensitivity();
+    tuning.joystick_max_sensitivity = get_joystick_max_sensitivity();
+    tuning.event_pair_window = get_event_pair_window_us() / EVENT_PAIR_WINDOW_UNIT_US;
+    for (uint button = 0; button < MAX_BUTTONS; ++button) {
+        const uint32_t lockout_us = get_button_lockout_us(button);
+        tuning.button_lockout_us[button] = lockout_us > UINT16_MAX ? UINT16_MAX : lockout_us;
+    }
+    uint16_t len = sizeof(tuning);
+    if (len > reqlen) {
+        len = reqlen;
+    }
+    memcpy(buffer, &tuning, len);
+    return len;
+}
+
+// Returns false if the report is malformed, or if the previous request has
+// not been applied yet
+bool request_tuning(const uint8_t* buffer, uint16_t len) {
+    if (len < sizeof(TuningReport) || TUNING_PENDING.load(std::memory_order_acquire)) {
+        return false;
+    }
+    TuningReport tuning;
+    memcpy(&tuning, buffer, sizeof(tuning));
+    if (!is_valid_tuning(tuning)) {
+        return false;
+    }
+    PENDING_TUNING = tuning;
+    TUNING_PENDING.store(true, std::memory_order_release);
+    return true;
+}
+
+bool is_tuning_pending() {
+    return TUNING_PENDING.load(std::memory_order_acquire);
+}
+
+void apply_pending_tuning() {
+    if (!TUNING_PENDING.load(std::memory_order_acquire)) [[likely]] {
+        return;
+    }
+    const TuningReport &tuning = PENDING_TUNING;
+    set_rotary_encoder_consensus(tuning.encoder_debounce_count, tuning.encoder_consensus_count);
+    set_joystick_sensitivity(tuning.joystick_sensitivity, tuning.joystick_max_sensitivity);
+    set_event_pair_window_us(tuning.event_pair_window * EVENT_PAIR_WINDOW_UNIT_US);
+    for (uint button = 0; button < MAX_BUTTONS; ++button) {
+        set_button_lockout_us(button, tuning.button_lockout_us[button]);
+    }
+    TUNING_PENDING.store(false, std::memory_order_release);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "button.hpp"
+#include "event.hpp"
+#include "joystick.hpp"
+
+#define TUNING_REPORT_ID 8  // Must match desc_hid_report
+
+// Bump whenever TuningReport changes shape. HIGH_RESOLUTION_AXES widens the
+// sensitivities, so it has its own.
+#ifdef HIGH_RESOLUTION_AXES
+#define TUNING_REPORT_VERSION 4
+#define TUNING_REPORT_LENGTH 40
+#else
+#define TUNING_REPORT_VERSION 3
+#define TUNING_REPORT_LENGTH 38
+#endif
+
+// The runtime parameters as a feature report, little endian like the core.
+// GET_REPORT returns the values in use. SET_REPORT replaces all of them at
+// once, and is ignored unless the version matches and every value is in
+// range. Lockouts of buttons that do not exist read back as 0 and are
+// ignored when set.
+struct TuningReport {
+    uint8_t version;
+    uint8_t encoder_debounce_count;
+    uint8_t encoder_consensus_count;
+    uint8_t event_pair_window;  // EVENT_PAIR_WINDOW_UNIT_US each, 0 turns cancelling off
+    JoystickSensitivity joystick_sensitivity;
+    JoystickSensitivity joystick_max_sensitivity;
+    uint16_t button_lockout_us[MAX_BUTTONS];
+};
+
+static_assert(sizeof(TuningReport) == TUNING_REPORT_LENGTH, "TuningReport must match its report descriptor");
+
+// USB side
+uint16_t get_tuning_report(uint8_t* buffer, uint16_t reqlen);
+bool request_tuning(const uint8_t* buffer, uint16_t len);
+
+// Input side. Changes requested over USB only take effect here, so they
+// never race the handlers
+void apply_pending_tuning();
+bool is_tuning_pending();
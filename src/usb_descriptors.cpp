@@ -23,8 +23,11 @@
  *
  */
 
+#include <string.h>
 #include "tusb.h"
 #include "descriptors.h"
+#include "report_descriptor.hpp"
+#include "tuning.hpp"
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
  * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
@@ -70,18 +73,31 @@ uint8_t const *tud_descriptor_device_cb(void)
 // HID Report Descriptor
 //--------------------------------------------------------------------+
 
-uint8_t const desc_hid_report[] =
+// Everything after the gamepad collection, which is generated from
+// CONTROLLER_LAYOUT (GAMEPAD_REPORT_DESCRIPTOR, report ID 1)
+static constexpr uint8_t desc_hid_report_tail[] =
     {
-        GAMECON_REPORT_DESC_GAMEPAD(HID_REPORT_ID(1)),
         GAMECON_REPORT_DESC_LIGHTS(HID_REPORT_ID(2)),
+        GAMECON_REPORT_DESC_TUNING(HID_REPORT_ID(8)),  // TUNING_REPORT_ID
+        GAMECON_REPORT_DESC_BOOT_TIMELINE(HID_REPORT_ID(12)),  // BOOT_TIMELINE_REPORT_ID
+#ifdef INSTRUMENTATION
+        // INSTRUMENTATION_COUNTERS_REPORT_ID, INSTRUMENTATION_HISTOGRAM_REPORT_ID, INSTRUMENTATION_ISR_REPORT_ID, INSTRUMENTATION_WAKE_REPORT_ID
+        GAMECON_REPORT_DESC_INSTRUMENTATION(3, 4, 10, 11),
+#endif
+#ifdef FLIGHT_RECORDER
+        GAMECON_REPORT_DESC_FLIGHT_RECORDER(HID_REPORT_ID(9)),  // FLIGHT_RECORDER_REPORT_ID
+#endif
         };
 
+static constexpr auto desc_hid_report = join_report_descriptors(GAMEPAD_REPORT_DESCRIPTOR, desc_hid_report_tail);
+
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 {
-    return desc_hid_report;
+    (void)instance;
+    return desc_hid_report.data();
 }
 
 //--------------------------------------------------------------------+
@@ -94,9 +110,10 @@ enum
     ITF_NUM_TOTAL
 };
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
 
-#define EPNUM_HID   0x81
+#define EPNUM_HID_OUT   0x01  // Light frames
+#define EPNUM_HID_IN    0x81
 
 uint8_t const desc_configuration[] =
         {
@@ -104,8 +121,8 @@ uint8_t const desc_configuration[] =
                 TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
                 // Interface number, string index, protocol, report descriptor len, EP In & Out address, size & polling interval
-                TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID,
-                                   CFG_TUD_HID_BUFSIZE, 1)
+                TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, desc_hid_report.size(), EPNUM_HID_OUT,
+                                         EPNUM_HID_IN, CFG_TUD_HID_BUFSIZE, 1)
         };
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
@@ -122,7 +139,7 @@ uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
 // array of pointer to string descriptors
 char const *string_desc_arr[] =
     {
-        (const char[]){0x09, 0x04}, // 0: is supported language is English (0x0409)
+        "\x09\x04",                 // 0: is supported language is English (0x0409)
         "Drewol",                   // 1: Manufacturer
         "RP2040 RhythmCon",         // 2: Product
         "123456",                   // 3: Serials, should use chip ID